@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Key scan data registers, one bit per key. The calculator's keys are
+// in the first four words, in the layout used by the SDK's key codes.
+#define KEYSC_DATA  ((volatile uint16_t *)0xA44B0000)
+
+inline void keysc_read(uint32_t *key1, uint32_t *key2)
+{
+  *key1 = ((uint32_t)KEYSC_DATA[0] << 16) | KEYSC_DATA[1];
+  *key2 = ((uint32_t)KEYSC_DATA[2] << 16) | KEYSC_DATA[3];
+}
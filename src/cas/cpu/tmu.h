@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include "cpg.h"
 
 #define TMU_TICKS_PER_SEC 7000000
 
@@ -57,4 +58,44 @@ union tmu_tcr
 // Channel 2
 #define TMU_TCOR_2  ((volatile uint32_t *) 0xA4490020)
 #define TMU_TCNT_2  ((volatile uint32_t *) 0xA4490024)
-#define TMU_TCR_2   ((volatile tmu_tcr *)  0xA4490028)
\ No newline at end of file
+#define TMU_TCR_2   ((volatile tmu_tcr *)  0xA4490028)
+
+// Lets channel 0 count down from the top, used as a free running clock.
+// Keeps counting if the clock already runs.
+inline void tmu_start_clock()
+{
+  if (TMU_TSTR->STR0)
+  {
+    return;
+  }
+
+  tmu_tcr temp_tcr = { .raw = 0 };
+  temp_tcr.TPSC = PHI_DIV_4;
+
+  TMU_TCR_0->raw = temp_tcr.raw;
+  *TMU_TCOR_0 = 0xFFFFFFFF;
+  *TMU_TCNT_0 = 0xFFFFFFFF;
+
+  TMU_TSTR->STR0 = 1;
+}
+
+inline void tmu_stop_clock()
+{
+  TMU_TSTR->STR0 = 0;
+}
+
+// Ticks since tmu_start_clock(), differences stay valid across a wrap
+inline uint32_t tmu_clock()
+{
+  return ~(*TMU_TCNT_0);
+}
+
+// Converts clock ticks to tenths of a millisecond
+inline uint32_t tmu_ticks_to_tenth_ms(uint32_t ticks)
+{
+  const uint32_t default_pll = CPG_PLL_MUL_DEFAULT + 1;
+  const uint32_t current_pll = CPG_FRQCRA->STC + 1;
+
+  // The TMU runs off the peripheral clock, which follows the PLL
+  return ticks / (((TMU_TICKS_PER_SEC / 10000) * current_pll) / default_pll);
+}
@@ -4,8 +4,10 @@
 
 #define SCREEN_DATA_REGISTER ((volatile uint32_t *)0xB4000000)
 
-inline void prepare_gb_lcd() 
+// Limits the LCD window to the given panel area. Pixels sent afterwards fill
+// the window line by line.
+inline void prepare_gb_lcd(uint16_t x, uint16_t width, uint16_t y, uint16_t height) 
 {
-  ((void(*)(int, int, int, int))0x80038068)(0, CAS_LCD_WIDTH - 1, 0, (LCD_HEIGHT * 2) - 1);
+  ((void(*)(int, int, int, int))0x80038068)(x, x + width - 1, y, y + height - 1);
   ((void(*)(int))0x80038040)(0x2c);
 }
@@ -4,12 +4,21 @@
 #include <sdk/os/file.hpp>
 #include "error.h"
 #include "emulator.h"
+#include "../helpers/arena.h"
 #include "../helpers/macros.h"
 #include "../helpers/fileio.h"
 #include "../helpers/functions.h"
 
 #define RAM_VAR_CONSTANT  "R_"
 
+#define AUTOSAVE_IDLE_FRAMES      120
+#define AUTOSAVE_PAGES_PER_FRAME  4
+
+static bool save_file_exists = false;
+static bool autosave_pending = false;
+static uint32_t autosave_writes = 0;
+static uint8_t autosave_idle = 0;
+
 // Gets the mcs varname of the current roms cart ram save
 // Make sure the buffer is big enough
 char *get_cart_ram_var_name(emu_preferences *preferences, char *name_buffer)
@@ -33,6 +42,57 @@ char *get_cart_ram_var_name(emu_preferences *preferences, char *name_buffer)
   return name_buffer;
 }
 
+// Gets the path of the current roms binary save file
+// Make sure the buffer is big enough
+char *get_cart_ram_path(emu_preferences *preferences, char *path_buffer, size_t len)
+{
+  strlcpy(path_buffer, DIRECTORY_SAVES "\\", len);
+  strlcat(path_buffer, preferences->current_filename, len);
+
+  // Replace the rom extension
+  char *extension = strrchr(path_buffer, '.');
+
+  if (extension && extension > strrchr(path_buffer, '\\'))
+  {
+    *extension = '\0';
+  }
+
+  strlcat(path_buffer, EXTENSION_SAVE, len);
+
+  return path_buffer;
+}
+
+// Converts a hex string save from the mcs and replaces it with a save file
+uint8_t migrate_mcs_cart_ram(struct gb_s *gb, size_t len)
+{
+  emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
+	char var_name[MAX_FILENAME_LEN];
+  char *mcs_data = nullptr;
+  uint32_t mcs_size = 0;
+
+	get_cart_ram_var_name(preferences, var_name);
+
+  // No save exists yet
+  if (read_mcs(MCS_DIRECTORY, var_name, (void **)&mcs_data, &mcs_size) || !mcs_data)
+  {
+    return 0;
+  }
+
+  // Convert to byte array
+  for (uint32_t i = 0; i + 1 < mcs_size && (i / 2) < len; i += 2)
+  {
+    char hex_byte[3] = { mcs_data[i], mcs_data[i + 1], '\0'};
+    preferences->cart_ram[i / 2] = strtol(hex_byte, nullptr, 16);
+  }
+
+  if (save_cart_ram(gb) != 0)
+  {
+    return 1;
+  }
+
+  return delete_mcs(MCS_DIRECTORY, var_name);
+}
+
 uint8_t load_cart_ram(struct gb_s *gb)
 {
   emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
@@ -45,8 +105,13 @@ uint8_t load_cart_ram(struct gb_s *gb)
 		return 0;
 	}
 
-	// Allocate enough memory to hold save file.
-	preferences->cart_ram = (uint8_t *)malloc(len);
+	// Allocate enough memory to hold save file, the rtc is kept behind the
+  // cart ram so the save can be read and written at once. A reload keeps 
+  // the memory of the rom.
+  if (!preferences->cart_ram)
+  {
+	  preferences->cart_ram = (uint8_t *)arena_alloc(&rom_arena, len + sizeof(gb->cart_rtc));
+  }
 
 	if(!preferences->cart_ram) 
   {
@@ -54,7 +119,7 @@ uint8_t load_cart_ram(struct gb_s *gb)
     char tmp[20];
 
     strlcpy(err_info, "Cart RAM: ", sizeof(err_info));
-    strlcat(err_info, itoa(len, tmp, 10), sizeof(err_info));
+    strlcat(err_info, itoa(len + sizeof(gb->cart_rtc), tmp, 10), sizeof(err_info));
     strlcat(err_info, "B", sizeof(err_info));
     
     set_error_i(EMALLOC, err_info);
@@ -63,26 +128,30 @@ uint8_t load_cart_ram(struct gb_s *gb)
   
   memset(preferences->cart_ram, 0xFF, len);
 
+  // Saves without rtc keep the current rtc
+  memcpy(preferences->cart_ram + len, gb->cart_rtc, sizeof(gb->cart_rtc));
+
 	// Load cart ram
-	char var_name[MAX_FILENAME_LEN];
-  char *mcs_data = nullptr;
-  uint32_t mcs_size = 0;
+  char path[MAX_FILENAME_LEN];
+  get_cart_ram_path(preferences, path, sizeof(path));
 
-	get_cart_ram_var_name(preferences, var_name);
+  autosave_pending = false;
+  autosave_writes = 0;
+  autosave_idle = 0;
+  save_file_exists = file_exists(path);
 
-  // If succesfully read data, convert copy it to cart ram
-  if (read_mcs(MCS_DIRECTORY, var_name, (void **)&mcs_data, &mcs_size) || !mcs_data)
+  if (!save_file_exists)
   {
-    return 1;
+    return migrate_mcs_cart_ram(gb, len);
   }
 
-  // Convert to byte array
-  for (uint32_t i = 0; i < mcs_size; i += 2)
+  if (read_file(path, preferences->cart_ram, len + sizeof(gb->cart_rtc)) != 0)
   {
-    char hex_byte[3] = { mcs_data[i], mcs_data[i + 1], '\0'};
-    preferences->cart_ram[i / 2] = strtol(hex_byte, nullptr, 16);
+    return 1;
   }
 
+  memcpy(gb->cart_rtc, preferences->cart_ram + len, sizeof(gb->cart_rtc));
+
   return 0;	
 }
 
@@ -97,24 +166,149 @@ uint8_t save_cart_ram(struct gb_s *gb)
 		return 0;
   }
 
-  // Convert byte array to hex string array
-  const uint32_t str_size = (len * 2) + 1;
-  const uint32_t var_size = align_val(str_size + 1, 4);
-  char var_contents[var_size];
-  
-  memset(var_contents, 0, var_size);
+  memcpy(preferences->cart_ram + len, gb->cart_rtc, sizeof(gb->cart_rtc));
+
+  // Fails if the directory already exists
+  mkdir(DIRECTORY_SAVES);
 
-  for (size_t i = 0; i < len; i++)
-  {  
-    itoa_leading_zeros(preferences->cart_ram[i], &(var_contents[(i * 2)]), 16, 2);
+	// Write cart ram
+  char path[MAX_FILENAME_LEN];
+  get_cart_ram_path(preferences, path, sizeof(path));
+
+	if (write_file(path, preferences->cart_ram, len + sizeof(gb->cart_rtc)) != 0)
+  {
+    return 1;
   }
 
-  // Add trailing 0 just to make sure
-  var_contents[str_size - 1] = '\0';
+  save_file_exists = true;
+  memset(gb->cram_dirty, 0, sizeof(gb->cram_dirty));
 
-	// Write cart rom
-	char var_name[MAX_FILENAME_LEN];
-	get_cart_ram_var_name(preferences, var_name);
+  return 0;
+}
+
+bool cart_ram_dirty(struct gb_s *gb)
+{
+  for (uint8_t i = 0; i < CRAM_DIRTY_WORDS; i++)
+  {
+    if (gb->cram_dirty[i])
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint8_t flush_cart_ram(struct gb_s *gb, uint16_t max_pages)
+{
+  emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
+  const uint32_t len = gb->cram_size;
+  uint16_t written = 0;
+
+	if(len == 0 || !(preferences->cart_ram))
+  {
+		return 0;
+  }
+
+  if (!save_file_exists)
+  {
+    return save_cart_ram(gb);
+  }
+
+  char path[MAX_FILENAME_LEN];
+  get_cart_ram_path(preferences, path, sizeof(path));
+
+  int32_t fd = open(path, OPEN_WRITE);
+
+  if (fd < 0)
+  {
+    set_error_i(EFOPEN, path);
+    return 1;
+  }
+
+  for (uint8_t i = 0; i < CRAM_DIRTY_WORDS && written < max_pages; i++)
+  {
+    while (gb->cram_dirty[i] && written < max_pages)
+    {
+      const uint8_t bit = __builtin_ctz(gb->cram_dirty[i]);
+      const uint32_t offset = ((i * 32) + bit) << CRAM_DIRTY_PAGE_SHIFT;
+      const uint32_t size = (len - offset < CRAM_DIRTY_PAGE_SIZE)? len - offset : CRAM_DIRTY_PAGE_SIZE;
+
+      // The page stays dirty unless all of it was written, so a failed 
+      // write is tried again later
+      if (lseek(fd, offset, SEEK_SET) < 0 
+        || write(fd, preferences->cart_ram + offset, size) != (int32_t)size)
+      {
+        close(fd);
+        set_error_i(EFWRITE, path);
+        return 1;
+      }
+
+      gb->cram_dirty[i] &= ~(1UL << bit);
+      written++;
+    }
+  }
 
-	return write_mcs(MCS_DIRECTORY, var_name, var_contents, var_size);	
+  // The rtc is written with the last pages
+  if (!cart_ram_dirty(gb))
+  {
+    memcpy(preferences->cart_ram + len, gb->cart_rtc, sizeof(gb->cart_rtc));
+
+    if (lseek(fd, len, SEEK_SET) < 0 
+      || write(fd, preferences->cart_ram + len, sizeof(gb->cart_rtc)) != (int32_t)sizeof(gb->cart_rtc))
+    {
+      close(fd);
+      set_error_i(EFWRITE, path);
+      return 1;
+    }
+  }
+
+  if (close(fd) < 0)
+  {
+    set_error_i(EFCLOSE, path);
+    return 1;
+  }
+
+  return 0;
+}
+
+void autosave_cart_ram(struct gb_s *gb)
+{
+  if (gb->cram_size == 0)
+  {
+    return;
+  }
+
+  // Count frames without cart ram writes
+  if (gb->cram_writes != autosave_writes)
+  {
+    autosave_writes = gb->cram_writes;
+    autosave_idle = 0;
+  }
+  else if (autosave_idle < AUTOSAVE_IDLE_FRAMES)
+  {
+    autosave_idle++;
+
+    if (autosave_idle == AUTOSAVE_IDLE_FRAMES)
+    {
+      autosave_pending = true;
+    }
+  }
+
+  if (gb->cram_save_request)
+  {
+    gb->cram_save_request = 0;
+    autosave_pending = true;
+  }
+
+  if (!autosave_pending)
+  {
+    return;
+  }
+
+  // Stop on errors, saving is tried again when the rom is closed
+  if (!cart_ram_dirty(gb) || flush_cart_ram(gb, AUTOSAVE_PAGES_PER_FRAME) != 0)
+  {
+    autosave_pending = false;
+  }
 }
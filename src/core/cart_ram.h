@@ -6,3 +6,17 @@
 uint8_t load_cart_ram(struct gb_s *gb);
 
 uint8_t save_cart_ram(struct gb_s *gb);
+
+/**
+ * Writes dirty cart ram pages to the save file, and the rtc once no dirty 
+ * page is left. Writes the whole save if there is no save file yet.
+ *   
+ * @param max_pages The maximum amount of pages to write
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t flush_cart_ram(struct gb_s *gb, uint16_t max_pages);
+
+// Writes a few dirty pages per frame once the game disabled cart ram or
+// did not write to it for a while
+void autosave_cart_ram(struct gb_s *gb);
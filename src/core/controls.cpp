@@ -6,6 +6,7 @@
 #include "preferences.h"
 #include "emulator.h"
 #include "error.h"
+#include "pref_store.h"
 #include "../helpers/fileio.h"
 #include "../helpers/functions.h"
 #include "../helpers/ini.h"
@@ -14,7 +15,6 @@
 #define CONTROLS_INI_VAR_NAME       "Controls"
 
 #define CONTROLS_INI_SECTION_NAME   "Ctrls"
-#define CONTROLS_INI_KEY_SEPERATOR  '_'
 
 void set_controls_defaults(emu_controls *controls)
 {
@@ -36,118 +36,118 @@ void set_controls_defaults(emu_controls *controls)
   (*controls)[GB_KEY_RIGHT][1] = DEFAULT_GB_KEY_RIGHT_1;
 }
 
-uint8_t process_controls_ini(char *ini_string, uint32_t len, emu_controls *controls)
+void build_controls_lut(emu_controls *controls, emu_controls_lut *lut)
 {
-  ini_file file;
-  ini_parse(ini_string, len, &file);
-
-  ini_section *section = find_section(&file, CONTROLS_INI_SECTION_NAME);
+  // Joypad bit of every GB key, in the order of the GB_KEY defines
+  static const uint8_t joypad_bits[GB_KEY_COUNT] = {
+    0x01, 0x02, 0x08, 0x04, 0x40, 0x80, 0x20, 0x10
+  };
 
-  if (!section)
+  for (uint8_t nibble = 0; nibble < 16; nibble++)
   {
-    free_ini_file(&file);
-    return 1;
-  }
+    uint8_t word = nibble / 8;
+    uint8_t shift = (nibble % 8) * 4;
 
-  for (uint8_t i = 0; i < GB_KEY_COUNT; i++) 
-  {
-    char a = '0' + i;
-    char key_name[4] = { a, CONTROLS_INI_KEY_SEPERATOR, '0', '\0' };
-
-    // Find the key for the first int of the controls array
-    ini_key *key_0 = find_key(section, key_name);
-    
-    if (!key_0)
+    for (uint8_t value = 0; value < 16; value++)
     {
-      free_ini_file(&file);
-      return 1;
+      uint8_t pressed = 0;
+
+      for (uint8_t key = 0; key < GB_KEY_COUNT; key++)
+      {
+        if (((*controls)[key][word] >> shift) & value)
+        {
+          pressed |= joypad_bits[key];
+        }
+      }
+
+      (*lut)[nibble][value] = pressed;
     }
+  }
+}
 
-    (*controls)[i][0] = key_0->value_int;
+// Every key has two words, stored as "<key>_<word>"
+#define CONTROLS_BIND(key, word) \
+  { \
+    CONTROLS_INI_SECTION_NAME, #key "_" #word, INI_FIELD_U32, \
+    ((key) * 2 + (word)) * sizeof(uint32_t), sizeof(uint32_t) \
+  }
 
-    key_name[2]++;
+static const ini_binding controls_bindings[] = 
+{
+  CONTROLS_BIND(0, 0), CONTROLS_BIND(0, 1),
+  CONTROLS_BIND(1, 0), CONTROLS_BIND(1, 1),
+  CONTROLS_BIND(2, 0), CONTROLS_BIND(2, 1),
+  CONTROLS_BIND(3, 0), CONTROLS_BIND(3, 1),
+  CONTROLS_BIND(4, 0), CONTROLS_BIND(4, 1),
+  CONTROLS_BIND(5, 0), CONTROLS_BIND(5, 1),
+  CONTROLS_BIND(6, 0), CONTROLS_BIND(6, 1),
+  CONTROLS_BIND(7, 0), CONTROLS_BIND(7, 1),
+};
+
+#define CONTROLS_BINDING_COUNT (sizeof(controls_bindings) / sizeof(controls_bindings[0]))
 
-    // Find the key for the second int of the controls array
-    ini_key *key_1 = find_key(section, key_name);
+uint8_t process_controls_ini(char *ini_string, uint32_t len, emu_controls *controls)
+{
+  uint32_t found = ini_read_bindings(ini_string, len, controls_bindings, 
+    CONTROLS_BINDING_COUNT, controls);
 
-    if (!key_1)
-    {
-      free_ini_file(&file);
-      return 1;
-    }
-    
-    (*controls)[i][1] = key_1->value_int;
+  // All keys have to be set
+  if (found != (1 << CONTROLS_BINDING_COUNT) - 1)
+  {
+    return 1;
   }
-
-  free_ini_file(&file);
   
   return 0;
 }
 
 char *create_controls_ini(emu_controls *controls, char *ini_string, uint32_t len)
 {
-  ini_file file;
-  file.section_count = 0;
-  file.sections_size = 0;
-  
-  ini_section *controls_section = add_section(&file, CONTROLS_INI_SECTION_NAME);
-  
-  if (!controls_section)
+  return ini_write_bindings(controls_bindings, CONTROLS_BINDING_COUNT, controls, 
+    ini_string, len);
+}
+
+uint8_t import_controls_ini(emu_controls *controls)
+{
+  uint32_t size;
+  char *ini_string;
+
+  if (read_mcs(MCS_DIRECTORY, CONTROLS_INI_VAR_NAME, (void **)&ini_string, &size))
   {
-    free_ini_file(&file);
-    return nullptr;
+    return 1;
   }
 
-  for (uint8_t i = 0; i < GB_KEY_COUNT; i++) 
-  {
-    char a = '0' + i;
-    char key_name[] = { a, CONTROLS_INI_KEY_SEPERATOR, '0', '\0' };
-  
-    if (!add_key(
-      controls_section, 
-      key_name,
-      INI_TYPE_INT,
-      (*controls)[i][0]
-    ))
-    {
-      free_ini_file(&file);
-      return nullptr;
-    }
+  return process_controls_ini(ini_string, size, controls);
+}
 
-    key_name[2]++;
+uint8_t export_controls_ini(emu_controls *controls)
+{
+  char ini_string[INI_MAX_CONTENT_LEN];
   
-    if (!add_key(
-      controls_section, 
-      key_name,
-      INI_TYPE_INT,
-      (*controls)[i][1]
-    ))
-    {
-      free_ini_file(&file);
-      return nullptr;
-    }
+  if (!create_controls_ini(controls, ini_string, sizeof(ini_string)))
+  {
+    return 1;
   }
 
-  ini_write(&file, ini_string, len);
-  free_ini_file(&file);
+  uint32_t size = align_val(strlen(ini_string), 4);
 
-  return ini_string;
+  return write_mcs(MCS_DIRECTORY, CONTROLS_INI_VAR_NAME, ini_string, size);
 }
 
-uint8_t load_controls(struct gb_s *gb)
+uint8_t load_controls(emu_controls *controls)
 {
-  emu_controls *controls = &(((emu_preferences *)(gb->direct.priv))->controls);
-  uint32_t size;
-  char *ini_string;
+  uint16_t count;
 
-  set_controls_defaults(controls);
+  if (pref_store_read(PREF_STORE_CONTROLS, controls, sizeof(emu_controls), 1, &count) == 0 
+    && count == 1)
+  {
+    return 0;
+  }
 
-  if (read_mcs(MCS_DIRECTORY, CONTROLS_INI_VAR_NAME, (void **)&ini_string, &size) == 0)
+  // Take over the ini file of an older version once, unless the store exists
+  // but was rejected. It is left alone until the user has been told about it.
+  if (errno != EPREFS && import_controls_ini(controls) == 0)
   {
-    if (process_controls_ini(ini_string, size, controls) == 0) 
-    {
-      return 0;
-    }
+    return save_controls(controls);
   }
 
   // Restore defaults when read failed
@@ -155,14 +155,7 @@ uint8_t load_controls(struct gb_s *gb)
   return 1;
 }
 
-uint8_t save_controls(struct gb_s *gb)
+uint8_t save_controls(emu_controls *controls)
 {
-  emu_controls *controls = &(((emu_preferences *)(gb->direct.priv))->controls);
-  char ini_string[INI_MAX_CONTENT_LEN];
-  
-  create_controls_ini(controls, ini_string, sizeof(ini_string));
-
-  uint32_t size = align_val(strlen(ini_string), 4);
-
-  return write_mcs(MCS_DIRECTORY, CONTROLS_INI_VAR_NAME, ini_string, size);
+  return pref_store_write(PREF_STORE_CONTROLS, controls, sizeof(emu_controls), 1);
 }
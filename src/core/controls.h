@@ -79,5 +79,29 @@
 
 typedef uint32_t emu_controls[GB_KEY_COUNT][2];
 
-uint8_t load_controls(struct gb_s *gb);
-uint8_t save_controls(struct gb_s *gb);
+// Pressed joypad bits for every nibble of the two key words
+typedef uint8_t emu_controls_lut[16][16];
+
+void build_controls_lut(emu_controls *controls, emu_controls_lut *lut);
+
+// Returns the active low joypad state for the pressed keys
+inline uint8_t controls_joypad(emu_controls_lut *lut, uint32_t key1, uint32_t key2)
+{
+  uint8_t pressed = 0;
+
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    pressed |= (*lut)[i][(key1 >> (i * 4)) & 0x0F];
+    pressed |= (*lut)[i + 8][(key2 >> (i * 4)) & 0x0F];
+  }
+
+  return ~pressed;
+}
+
+// Loads the controls of the binary store, defaults are set if it fails
+uint8_t load_controls(emu_controls *controls);
+uint8_t save_controls(emu_controls *controls);
+
+// The ini file is only used to export or import the controls
+uint8_t import_controls_ini(emu_controls *controls);
+uint8_t export_controls_ini(emu_controls *controls);
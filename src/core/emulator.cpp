@@ -5,12 +5,18 @@
 #include <string.h>
 #include <sdk/calc/calc.hpp>
 #include <sdk/os/file.hpp>
-#include <sdk/os/input.hpp>
 #include <sdk/os/debug.hpp>
 #include "controls.h"
 #include "cart_ram.h"
 #include "error.h"
 #include "frametimes.h"
+#include "keyboard.h"
+#include "latency.h"
+#include "movie.h"
+#include "rewind.h"
+#include "rom_cache.h"
+#include "savestate.h"
+#include "scaler.h"
 #include "peanut_gb.h"
 #include "../cas/display.h"
 #include "../cas/cpu/cmt.h"
@@ -18,47 +24,102 @@
 #include "../cas/cpu/dmac.h"
 #include "../cas/cpu/oc_mem.h"
 #include "../cas/cpu/stack.h"
+#include "../cas/cpu/tmu.h"
+#include "../emu_ui/backbuffer.h"
 #include "../emu_ui/menu/menu.h"
+#include "../helpers/arena.h"
 #include "../helpers/macros.h"
 #include "../helpers/functions.h"
 #include "../helpers/fileio.h"
 
 #define INPUT_NONE      0
 #define INPUT_OPEN_MENU 1
+#define INPUT_REWIND    2
+
+#define REWIND_KEY      KEY_BACKSPACE
+
+#define LAZY_INPUT_SAMPLES  4
+#define LAZY_INPUT_LINE_GAP 16
 
 #define STACK_PTR_ADDR  (void *)((uint32_t)Y_MEMORY_1 + (0x1000 - 4))
 
 /* Global arrays in OC-Memory */
-uint8_t gb_wram[WRAM_SIZE];
-uint8_t gb_vram[VRAM_SIZE] __attribute__((section(".oc_mem.x")));
-uint8_t gb_oam[OAM_SIZE] __attribute__((section(".oc_mem.y.data")));
-uint8_t gb_hram_io[HRAM_IO_SIZE] __attribute__((section(".oc_mem.y.data")));
+// Word aligned, rewind snapshots compare memory word by word
+uint8_t gb_wram[WRAM_SIZE] __attribute__((aligned(4)));
+uint8_t gb_vram[VRAM_SIZE] __attribute__((section(".oc_mem.x"), aligned(4)));
+uint8_t gb_oam[OAM_SIZE] __attribute__((section(".oc_mem.y.data"), aligned(4)));
+uint8_t gb_hram_io[HRAM_IO_SIZE] __attribute__((section(".oc_mem.y.data"), aligned(4)));
+
+/* Line with two pixels per word for the 1x scaler, only used once the
+ * previous transfer has finished */
+uint32_t lcd_packed_line[LCD_WIDTH / 2] __attribute__((section(".oc_mem.y.data")));
+
+/* Line the LCD window continues with, lines that are not sent in order
+ * need a new window */
+static uint8_t lcd_next_line = LCD_HEIGHT;
+
+/* Joypad state for every key nibble, rebuilt whenever the controls may
+ * have changed */
+static emu_controls_lut controls_lut;
+
+/* JOYP reads left this frame that may sample the keys, and the line of
+ * the last sample */
+static uint8_t lazy_input_budget = 0;
+static uint8_t lazy_input_line = 0;
+
+// Reads the keyboard and updates the joypad state
+static void sample_joypad(struct gb_s *gb, uint32_t *key1, uint32_t *key2)
+{
+  const uint8_t previous_joypad = gb->direct.joypad;
 
-uint8_t execution_handle_input(struct gb_s *gb)
+  keyboard_read(key1, key2);
+
+  gb->direct.joypad = controls_joypad(&controls_lut, *key1, *key2);
+
+  latency_input(gb, previous_joypad);
+}
+
+// Samples the keys when the game reads JOYP, at most a few times per frame
+static void lazy_joypad_sample(struct gb_s *gb)
 {
+  const uint8_t line = gb->hram_io[IO_LY];
   uint32_t key1;
   uint32_t key2;
 
-  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
-
-  // Handle Key Input
-  getKey(&key1, &key2);
+  if (lazy_input_budget == 0)
+  {
+    return;
+  }
 
-  // Skip this function if no keys are pressed
-  if (!Input_IsAnyKeyDown())
+  // Games read JOYP several times in a row, only the first read of such
+  // a burst samples the keys
+  if (lazy_input_budget != LAZY_INPUT_SAMPLES)
   {
-    key1 = 0;
-    key2 = 0;
+    uint8_t gap = (line >= lazy_input_line)? 
+      line - lazy_input_line : line + LCD_VERT_LINES - lazy_input_line;
+
+    if (gap < LAZY_INPUT_LINE_GAP)
+    {
+      return;
+    }
   }
 
-  gb->direct.joypad_bits.a =      !((key1 & preferences->controls[GB_KEY_A][0])       | (key2 & preferences->controls[GB_KEY_A][1]));
-  gb->direct.joypad_bits.b =      !((key1 & preferences->controls[GB_KEY_B][0])       | (key2 & preferences->controls[GB_KEY_B][1]));
-  gb->direct.joypad_bits.start =  !((key1 & preferences->controls[GB_KEY_START][0])   | (key2 & preferences->controls[GB_KEY_START][1]));
-  gb->direct.joypad_bits.select = !((key1 & preferences->controls[GB_KEY_SELECT][0])  | (key2 & preferences->controls[GB_KEY_SELECT][1]));
-  gb->direct.joypad_bits.up =     !((key1 & preferences->controls[GB_KEY_UP][0])      | (key2 & preferences->controls[GB_KEY_UP][1]));
-  gb->direct.joypad_bits.down =   !((key1 & preferences->controls[GB_KEY_DOWN][0])    | (key2 & preferences->controls[GB_KEY_DOWN][1]));
-  gb->direct.joypad_bits.left =   !((key1 & preferences->controls[GB_KEY_LEFT][0])    | (key2 & preferences->controls[GB_KEY_LEFT][1]));
-  gb->direct.joypad_bits.right =  !((key1 & preferences->controls[GB_KEY_RIGHT][0])   | (key2 & preferences->controls[GB_KEY_RIGHT][1]));
+  lazy_input_budget--;
+  lazy_input_line = line;
+
+  sample_joypad(gb, &key1, &key2);
+}
+
+uint8_t execution_handle_input(struct gb_s *gb)
+{
+  uint32_t key1;
+  uint32_t key2;
+
+  // Handle Key Input
+  sample_joypad(gb, &key1, &key2);
+
+  // Refill the JOYP sampling budget for the next frame
+  lazy_input_budget = LAZY_INPUT_SAMPLES;
 
   // Check if menu should be opened
   if (testKey(key1, key2, KEY_NEGATIVE))
@@ -66,9 +127,33 @@ uint8_t execution_handle_input(struct gb_s *gb)
     return INPUT_OPEN_MENU;
   }
 
+  // Rewinding would break the recorded input
+  if (rewind_enabled() && !movie_active() && testKey(key1, key2, REWIND_KEY))
+  {
+    return INPUT_REWIND;
+  }
+
   return INPUT_NONE;
 }
 
+// Applies the frameskip settings from the rom config to the emulator
+static void apply_frameskip(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  uint8_t skipped_frames = 0;
+
+  if (preferences->config.frameskip_enabled)
+  {
+    skipped_frames = (preferences->config.frameskip_auto)?
+      preferences->config.frameskip_auto_amount : preferences->config.frameskip_amount;
+  }
+
+  gb->direct.frame_skip = (skipped_frames != 0);
+  gb->direct.frame_skip_amount = (skipped_frames + 1);
+
+  frametime_counter_set(gb);
+}
+
 void set_frameskip(struct gb_s *gb, bool enabled, uint8_t amount)
 {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
@@ -78,21 +163,55 @@ void set_frameskip(struct gb_s *gb, bool enabled, uint8_t amount)
   if (
     enabled == preferences->config.frameskip_enabled 
     && new_amount == preferences->config.frameskip_amount
-    && enabled == gb->direct.frame_skip 
-    && new_amount == (gb->direct.frame_skip_amount + 1) 
   )
   {
     return;
   }
 
-  gb->direct.frame_skip = enabled;
-  gb->direct.frame_skip_amount = (new_amount + 1);
   preferences->config.frameskip_enabled = enabled;
   preferences->config.frameskip_amount = new_amount;    
 
+  // In auto mode the amount is the upper bound
+  if (preferences->config.frameskip_auto_amount > new_amount)
+  {
+    preferences->config.frameskip_auto_amount = new_amount;
+  }
+
   preferences->file_states.rom_config_changed = true;
 
-  frametime_counter_set(gb);
+  apply_frameskip(gb);
+}
+
+void set_frameskip_auto(struct gb_s *gb, bool enabled)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  if (enabled == preferences->config.frameskip_auto)
+  {
+    return;
+  }
+
+  preferences->config.frameskip_auto = enabled;
+  preferences->file_states.rom_config_changed = true;
+
+  apply_frameskip(gb);
+}
+
+void set_frameskip_auto_amount(struct gb_s *gb, uint8_t amount)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  uint8_t new_amount = clamp(amount, (uint8_t)0, preferences->config.frameskip_amount);
+
+  if (new_amount == preferences->config.frameskip_auto_amount)
+  {
+    return;
+  }
+
+  // Persisted as the starting point for the next session
+  preferences->config.frameskip_auto_amount = new_amount;
+  preferences->file_states.rom_config_changed = true;
+
+  apply_frameskip(gb);
 }
 
 void set_interlacing(struct gb_s *gb, bool enabled)
@@ -114,6 +233,26 @@ void set_interlacing(struct gb_s *gb, bool enabled)
   preferences->file_states.rom_config_changed = true;
 }
 
+void set_scaler(struct gb_s *gb, uint8_t mode)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  if (mode >= SCALER_COUNT)
+  {
+    mode = SCALER_2X;
+  }
+
+  scaler_prepare(mode);
+
+  if (mode == preferences->config.scaler)
+  {
+    return;
+  }
+
+  preferences->config.scaler = mode;
+  preferences->file_states.rom_config_changed = true;
+}
+
 void set_emu_speed(struct gb_s *gb, uint16_t percentage){
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
   
@@ -142,21 +281,80 @@ void set_overclock(struct gb_s *gb, bool enabled)
   frametime_counter_set(gb);
 }
 
+void set_rewind(struct gb_s *gb, bool enabled, uint8_t interval, uint8_t buffer)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  uint8_t new_interval = clamp(interval, (uint8_t)REWIND_INTERVAL_MIN, (uint8_t)REWIND_INTERVAL_MAX);
+  uint8_t new_buffer = clamp(buffer, (uint8_t)REWIND_BUFFER_MIN, (uint8_t)REWIND_BUFFER_MAX);
+
+  // Check if anything should be changed
+  if (
+    enabled == preferences->config.rewind_enabled
+    && new_interval == preferences->config.rewind_interval
+    && new_buffer == preferences->config.rewind_buffer
+    && enabled == rewind_enabled()
+  )
+  {
+    return;
+  }
+
+  preferences->config.rewind_enabled = enabled;
+  preferences->config.rewind_interval = new_interval;
+  preferences->config.rewind_buffer = new_buffer;
+
+  preferences->file_states.rom_config_changed = true;
+
+  if (!enabled)
+  {
+    rewind_close();
+    return;
+  }
+
+  // Stays disabled if there is not enough memory, which the menu shows
+  rewind_open(gb, new_interval, new_buffer * REWIND_BUFFER_STEP);
+}
+
+void set_lazy_input(struct gb_s *gb, bool enabled)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  // Movies only change the joypad between frames
+  gb->gb_joypad_sample = (enabled && !movie_active())? lazy_joypad_sample : nullptr;
+
+  // Check if anything should be changed
+  if (preferences->config.lazy_input == enabled)
+  {
+    return;
+  }
+
+  preferences->config.lazy_input = enabled;
+  preferences->file_states.rom_config_changed = true;
+}
+
 // Draws scanline into framebuffer.
 void lcd_draw_line(struct gb_s *gb, const uint32_t pixels[160],
   const uint_fast8_t line)
 {
 	emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  const scaler_table *scaler = &gb_scaler;
+  const uint16_t row_count = scaler->rows[line + 1] - scaler->rows[line];
 
   // Wait for previous DMA to complete
   dma_wait(DMAC_CHCR_0);
+  latency_dma_done();
 
-  if (unlikely(line == 0))
+  // Interlacing and unchanged lines leave gaps
+  if (line != lcd_next_line)
   {
-    prepare_gb_lcd();
+    prepare_gb_lcd(scaler->x, scaler->width, scaler->rows[line], 
+      scaler->rows[LCD_HEIGHT] - scaler->rows[line]);
   }
 
-  // When emulator will be paused, render a full frame in vram
+  lcd_next_line = line + 1;
+
+  // When emulator will be paused, render a full frame in vram. The menu 
+  // expects a 2x frame, whatever the scaler is.
   if (unlikely(preferences->emulator_paused))
   {
     for (uint16_t i = 0; i < LCD_WIDTH; i++)
@@ -165,9 +363,27 @@ void lcd_draw_line(struct gb_s *gb, const uint32_t pixels[160],
       *(uint32_t *)&vram[(i * 2) + (((line * 2) + 1) * CAS_LCD_WIDTH)] = pixels[i];
     }
 
+    lcd_next_line = LCD_HEIGHT;
     return;
   }
 
+  const uint32_t *src = pixels;
+
+  // Pixels are stored twice per word, keep one of them
+  if (scaler->pixel_width == 1)
+  {
+    for (uint8_t i = 0; i < LCD_WIDTH / 2; i++)
+    {
+      lcd_packed_line[i] = (pixels[i * 2] & 0xFFFF0000) 
+        | (pixels[(i * 2) + 1] & 0x0000FFFF);
+    }
+
+    src = lcd_packed_line;
+  }
+
+  // Transfers per panel row, (pixels per row * bytes per pixel) / dmac operation bytes
+  const uint32_t row_transfers = (scaler->width * 2) / 32;
+
   // Initialize DMA settings
   dmac_chcr tmp_chcr = { .raw = 0 };
   tmp_chcr.TS_0 = SIZE_32_0;
@@ -180,29 +396,18 @@ void lcd_draw_line(struct gb_s *gb, const uint32_t pixels[160],
   tmp_chcr.DE   = 1;
 
   DMAC_CHCR_0->raw = 0;
-#if PEANUT_FULL_GBC_SUPPORT
-	if (gb->cgb.cgbMode)
-	{
-		uint32_t pixels_cgb[160];
-		for (unsigned int x = 0; x < LCD_WIDTH; x++)
-		{
-			 pixels_cgb[x]=gb->cgb.fixPalette[pixels[x]];
-		} 
-		*DMAC_SAR_0   = (uint32_t)pixels_cgb; 
-	}
-	else {
-#endif
-  *DMAC_SAR_0   = (uint32_t)pixels;                            // P4 Area (OC-Memory) => Physical address is same as virtual
-#if PEANUT_FULL_GBC_SUPPORT
-	}
-#endif
+  *DMAC_SAR_0   = (uint32_t)src;                               // P4 Area (OC-Memory) => Physical address is same as virtual
   *DMAC_DAR_0   = (uint32_t)SCREEN_DATA_REGISTER & 0x1FFFFFFF; // P2 Area => Physical address is virtual with 3 ms bits cleared
-  *DMAC_TCR_0   = (CAS_LCD_WIDTH * 2) / 32 * 2;                // (Pixels per line * bytes per pixel) / dmac operation bytes * 2 lines      
-  *DMAC_TCRB_0  = ((CAS_LCD_WIDTH * 2 / 32) << 16) 
-    | (CAS_LCD_WIDTH * 2 / 32);
+  *DMAC_TCR_0   = row_transfers * row_count;                   // The source is reloaded for every panel row
+  *DMAC_TCRB_0  = (row_transfers << 16) | row_transfers;
 
   // Start Channel 0
   DMAC_CHCR_0->raw = tmp_chcr.raw;
+
+  if (unlikely(latency_enabled()))
+  {
+    latency_line(pixels, line);
+  }
 }
 
 // Handles an error reported by the emulator. The emulator context may be used
@@ -248,6 +453,9 @@ uint8_t prepare_emulator(struct gb_s *gb, emu_preferences *preferences)
 
   // Initialise emulator context
   gb_ret = gb_init(gb, &gb_error, preferences, gb_wram, gb_vram, gb_oam, gb_hram_io, preferences->rom);
+
+  // Only bank 0 is in memory, the other banks are loaded when selected
+  gb_set_rom_bank_read(gb, &rom_cache_bank);
   
   // Add ROM name to preference struct
   gb_get_rom_name(gb, preferences->current_rom_name);
@@ -282,15 +490,38 @@ uint8_t prepare_emulator(struct gb_s *gb, emu_preferences *preferences)
   // Initialise lcd stuff 
   gb_init_lcd(gb, &lcd_draw_line);
 
+  preferences->bg_cache = (struct gb_bg_cache *)arena_alloc(&rom_arena, sizeof(struct gb_bg_cache));
+
+  if (!preferences->bg_cache)
+  {
+    char err_info[ERROR_MAX_INFO_LEN];
+    char tmp[20];
+
+    strlcpy(err_info, "BG cache: ", sizeof(err_info));
+    strlcat(err_info, itoa(sizeof(struct gb_bg_cache), tmp, 10), sizeof(err_info));
+    strlcat(err_info, "B", sizeof(err_info));
+
+    set_error_i(EMALLOC, err_info);
+    return 1;
+  }
+
+  gb_set_bg_cache(gb, preferences->bg_cache);
+
   // Load cart save
   load_cart_ram(gb);
   gb_set_cram(gb, preferences->cart_ram);
 
-  // Load user configs
+  // Continue where the rom was suspended. Needs the memory above, so this
+  // is as early after gb_init() as it can be.
+  if (resume_state(gb) == RESUME_BROKEN)
+  {
+    restart_broken_state(gb);
+  }
+
+  // Controls and user palettes were loaded at startup, the config is 
+  // looked up in the stored ones
   load_rom_config(gb);
-  load_controls(gb);
 
-  preferences->file_states.controls_changed = false;
   preferences->file_states.rom_config_changed = false;
   
   if (load_palettes(gb))
@@ -298,8 +529,6 @@ uint8_t prepare_emulator(struct gb_s *gb, emu_preferences *preferences)
     return 1;
   }
 
-  // load_savestates();
-
   // check if loaded palette is out of range
   if (preferences->config.selected_palette >= preferences->palette_count) 
   {
@@ -307,6 +536,8 @@ uint8_t prepare_emulator(struct gb_s *gb, emu_preferences *preferences)
     preferences->config.selected_palette = 0;
   }
 
+  gb_update_palette_lut(gb);
+
   // Set default flags
   preferences->emulator_paused = false;
 
@@ -318,15 +549,42 @@ void free_emulator(struct gb_s *gb)
 {
   emu_preferences *prefs = (emu_preferences *)gb->direct.priv;
 
-  free(prefs->rom);
-  free(prefs->cart_ram);
-  free(prefs->palettes);
+  rom_cache_close();
+  prefs->rom = nullptr;
+  prefs->cart_ram = nullptr;
+  prefs->bg_cache = nullptr;
+  prefs->palettes = nullptr;
+
+  if (latency_enabled())
+  {
+    latency_enable(gb, false);
+  }
+
+  movie_close(gb);
+  rewind_close();
+  tmu_stop_clock();
+
+  // Everything the rom allocated goes back to the heap at once
+  arena_reset(&rom_arena);
 }
 
-uint8_t close_rom(struct gb_s *gb)
+uint8_t close_rom(struct gb_s *gb, bool suspend)
 {
   emu_preferences *prefs = (emu_preferences *)gb->direct.priv;
-  uint8_t return_code = save_cart_ram(gb);
+  uint8_t return_code = movie_stop(gb);
+
+  // Only the pages changed since the last autosave are left. A replay 
+  // changed the game without the player, so nothing of it is kept.
+  if (!movie_holds_saves())
+  {
+    return_code |= flush_cart_ram(gb, UINT16_MAX);
+  }
+
+  // Let the next start continue right here
+  if (suspend && !movie_holds_saves())
+  {
+    return_code |= suspend_state(gb);
+  }
 
   if (prefs->file_states.rom_config_changed)
   {
@@ -342,8 +600,16 @@ uint8_t execute_rom(struct gb_s *gb)
 {
 
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  bool rewinding = false;
 
   frametime_counter_set(gb);
+  build_controls_lut(&preferences->controls, &controls_lut);
+  set_lazy_input(gb, preferences->config.lazy_input);
+
+  // Clear what is left of the menu preview around the picture
+  scaler_clear_border();
+  LCD_Refresh();
+
   for (;;)
   {
     frametime_counter_start();
@@ -356,7 +622,19 @@ uint8_t execute_rom(struct gb_s *gb)
       gb_tick_rtc(gb);
     }
 
+    // Go back one snapshot, the frame then shows the restored state
+    if (unlikely(rewinding))
+    {
+      rewind_step(gb);
+    }
+
+    // Record the joypad or replace it with the recorded one
+    movie_frame(gb);
+
     void *tmp_stack_ptr_bak = get_stack_ptr(); 
+
+    // Banks missing from the cache are read on the normal stack
+    rom_cache_set_file_stack(tmp_stack_ptr_bak);
     set_stack_ptr(STACK_PTR_ADDR);
 
     // Run CPU until next frame
@@ -365,7 +643,26 @@ uint8_t execute_rom(struct gb_s *gb)
 	  
 
     set_stack_ptr(tmp_stack_ptr_bak);
+    rom_cache_set_file_stack(nullptr);
 
+    // A missing bank would have the game run on open bus values
+    if (unlikely(rom_cache_check_reads() != 0))
+    {
+      return MENU_CRASH;
+    }
+
+    latency_frame_done();
+    movie_frame_done(gb);
+
+    if (!rewinding && !movie_active())
+    {
+      rewind_frame(gb);
+    }
+
+    if (!movie_holds_saves())
+    {
+      autosave_cart_ram(gb);
+    }
     frametime_counter_wait(gb);
 
     // Check if pause menu should be displayed
@@ -379,15 +676,31 @@ uint8_t execute_rom(struct gb_s *gb)
       }
 
       preferences->emulator_paused = false;
+      gb->direct.interlace = preferences->config.interlacing_enabled;
+
+      // Controls may have been changed in the menu
+      build_controls_lut(&preferences->controls, &controls_lut);
 
+      scaler_clear_border();
       LCD_Refresh();
+
+      // The menu drew over the last frame
+      gb_redraw_frame(gb);
     }
 
     // Handle input
-    if (unlikely(execution_handle_input(gb) == INPUT_OPEN_MENU))
+    const uint8_t input = execution_handle_input(gb);
+
+    rewinding = (input == INPUT_REWIND);
+
+    if (unlikely(input == INPUT_OPEN_MENU))
     {
       // Do not actually open the menu, but render another frame for gb preview first
       preferences->emulator_paused = true;
+
+      // The preview needs every line, not just one field or the changed ones
+      gb->direct.interlace = false;
+      gb_redraw_frame(gb);
     }
   }
 }
@@ -396,6 +709,32 @@ uint8_t run_emulator(struct gb_s *gb, emu_preferences *prefs)
 {
   bool exit_emulator = false;
 
+  // Taken before anything else, so the screen copies stay at the bottom of
+  // the session arena
+  if (backbuffer_init() != 0)
+  {
+    return 1;
+  }
+
+  // Preferences that are the same for every rom are only read once
+  if (load_preferences(prefs) != 0)
+  {
+    return 1;
+  }
+
+  // Rejected stores are replaced with the next save, so tell the user first
+  if (prefs->file_states.stores_rejected)
+  {
+    char text[ERROR_MAX_INFO_LEN + 80];
+
+    strlcpy(text, get_error_string(EPREFS), sizeof(text));
+    strlcat(text, "\n", sizeof(text));
+    strlcat(text, error_info, sizeof(text));
+    strlcat(text, "\n\nDefaults are used instead.", sizeof(text));
+
+    error_gen_alert(text);
+  }
+
   // Show load menu
   switch (load_menu(prefs))
   {
@@ -436,8 +775,9 @@ uint8_t run_emulator(struct gb_s *gb, emu_preferences *prefs)
     switch (execute_rom(gb))
     {
       case MENU_CRASH:
-        // Try to normaly close the rom, but this may fail
-        close_rom(gb);
+        // Try to normaly close the rom, but this may fail. The state may be
+        // what crashed, so it is not kept.
+        close_rom(gb, false);
         return 1;
 
       case MENU_EMU_QUIT:
@@ -448,7 +788,7 @@ uint8_t run_emulator(struct gb_s *gb, emu_preferences *prefs)
     }
 
 
-    if (close_rom(gb) != 0)
+    if (close_rom(gb, true) != 0)
     {
       return 1;
     }
@@ -456,7 +796,7 @@ uint8_t run_emulator(struct gb_s *gb, emu_preferences *prefs)
 
   if (prefs->file_states.controls_changed)
   {
-    if (save_controls(gb) != 0)
+    if (save_controls(&(prefs->controls)) != 0)
     {
       return 1;
     }
@@ -471,38 +811,6 @@ uint8_t load_rom(emu_preferences *prefs)
   strncat(rom_filename, prefs->current_filename, MAX_FILENAME_LEN - 1);
   rom_filename[MAX_FILENAME_LEN - 1] = '\0';
 
-
-  size_t rom_size;
-	
-	if (get_file_size(rom_filename, &rom_size))
-  {
-    return 1;
-  }
-
-
-	// dynamically allocate space for rom in heap
-	prefs->rom = (uint8_t *)malloc(rom_size);
-
-	// check if pointer to rom is no nullptr
-	if (!prefs->rom)
-  {
-
-    char err_info[ERROR_MAX_INFO_LEN];
-    char tmp[20];
-
-    strlcpy(err_info, "GB ROM: ", sizeof(err_info));
-    strlcat(err_info, itoa(rom_size, tmp, 10), sizeof(err_info));
-    strlcat(err_info, "B", sizeof(err_info));
-    
-    set_error_i(EMALLOC, err_info);
-		return 1;
-  }
-
-
-  if(read_file(rom_filename, prefs->rom, rom_size) != 0)
-  {
-    return 1;
-  }
-
-  return 0;
+  // Only reads bank 0, switchable banks are read when the game selects them
+  return rom_cache_open(rom_filename, &prefs->rom);
 }
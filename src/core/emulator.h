@@ -14,17 +14,28 @@
 
 void set_frameskip(struct gb_s *gb, bool enabled, uint8_t amount);
 
+void set_frameskip_auto(struct gb_s *gb, bool enabled);
+
+void set_frameskip_auto_amount(struct gb_s *gb, uint8_t amount);
+
 void set_interlacing(struct gb_s *gb, bool enabled);
 
+void set_scaler(struct gb_s *gb, uint8_t mode);
+
 void set_emu_speed(struct gb_s *gb, uint16_t percentage);
 
 void set_overclock(struct gb_s *gb, bool enabled);
 
+void set_lazy_input(struct gb_s *gb, bool enabled);
+
+void set_rewind(struct gb_s *gb, bool enabled, uint8_t interval, uint8_t buffer);
+
 uint8_t execute_rom(struct gb_s *gb);
 
 uint8_t prepare_emulator(struct gb_s *gb, emu_preferences *preferences);
 
-uint8_t close_rom(struct gb_s *gb);
+// Suspending writes the state to the rom's resume file
+uint8_t close_rom(struct gb_s *gb, bool suspend);
 
 void free_emulator(struct gb_s *gb);
 
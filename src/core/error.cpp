@@ -19,6 +19,8 @@ const char *error_messages[] = {
   ERROR_MSG_EEMUCHECKSUM,
   ERROR_MSG_EEMUGEN,
   ERROR_MSG_ESTRBUFEMPTY,
+  ERROR_MSG_ESTATE,
+  ERROR_MSG_EPREFS,
 };
 
 uint8_t errno;
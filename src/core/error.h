@@ -12,6 +12,8 @@
 #define EEMUCHECKSUM    7
 #define EEMUGEN         8
 #define ESTRBUFEMPTY    9
+#define ESTATE          10
+#define EPREFS          11
 
 #define ERROR_MSG_EMALLOC             "Failed to allocate memory"
 #define ERROR_MSG_EFOPEN              "Failed to open file"
@@ -23,6 +25,8 @@
 #define ERROR_MSG_EEMUCHECKSUM        "ROM Checksum failure"
 #define ERROR_MSG_EEMUGEN             "Unknown error on emulator context initialization"
 #define ERROR_MSG_ESTRBUFEMPTY        "The string buffer ran out of space"
+#define ERROR_MSG_ESTATE              "Save state is from another ROM or version"
+#define ERROR_MSG_EPREFS              "Preferences are damaged or from another version"
 #define ERROR_MSG_GEN_EMULATOR_RETRY  "Please try a different ROM"
 #define ERROR_MSG_GEN_EMULATOR_QUIT   "The emulator will now quit"
 
@@ -8,11 +8,83 @@
 
 #define FRAME_TARGET 60
 
+// Frames without a new picture (LCD off, blank or unchanged) do not wait for
+// their period. Up to this many of them run ahead before pacing kicks in.
+#define RUN_AHEAD_MAX 3
+
+// Auto frameskip: load is the share of the frame period budget (in percent)
+// spent emulating and drawing, averaged over the last few drawn frames
+#define AUTO_FS_LOAD_RAISE    95
+#define AUTO_FS_LOAD_LOWER    70
+#define AUTO_FS_LOAD_OVERRUN  125
+#define AUTO_FS_AVG_SHIFT     3
+#define AUTO_FS_HOLD_PERIODS  30
+
+// Whether the current frame period is already being timed. A period covers
+// all skipped frames and the drawn frame that ends it.
+static bool counter_running = false;
+
+static uint8_t run_ahead_frames = 0;
+static bool period_ran_ahead = false;
+
+// Load average scaled by (1 << AUTO_FS_AVG_SHIFT)
+static uint16_t auto_load_avg = 0;
+static uint8_t auto_hold_periods = 0;
+
+// Starts the average in between both thresholds so a fresh setting is kept
+// until real measurements say otherwise
+static void auto_frameskip_reset()
+{
+  auto_load_avg = ((AUTO_FS_LOAD_RAISE + AUTO_FS_LOAD_LOWER) / 2) << AUTO_FS_AVG_SHIFT;
+  auto_hold_periods = AUTO_FS_HOLD_PERIODS;
+}
+
+static void auto_frameskip_sample()
+{
+  uint32_t load = AUTO_FS_LOAD_OVERRUN;
+
+  // The counter stops at the compare value, so an overrun can not be measured
+  if (!CMT_CMCSR->CMF)
+  {
+    load = (*CMT_CMCNT * 100) / *CMT_CMCOR;
+  }
+
+  auto_load_avg += load - (auto_load_avg >> AUTO_FS_AVG_SHIFT);
+}
+
+static void auto_frameskip_update(struct gb_s *gb)
+{
+  emu_preferences *pref = (emu_preferences *)gb->direct.priv;
+  uint16_t load = auto_load_avg >> AUTO_FS_AVG_SHIFT;
+  uint8_t amount = pref->config.frameskip_auto_amount;
+
+  if (auto_hold_periods)
+  {
+    auto_hold_periods--;
+    return;
+  }
+
+  if (load > AUTO_FS_LOAD_RAISE && amount < pref->config.frameskip_amount)
+  {
+    amount++;
+  }
+  else if (load < AUTO_FS_LOAD_LOWER && amount > 0)
+  {
+    amount--;
+  }
+  else
+  {
+    return;
+  }
+
+  // Resets the controller through frametime_counter_set()
+  set_frameskip_auto_amount(gb, amount);
+}
+
 void frametime_counter_set(struct gb_s *gb)
 {
   emu_preferences *pref = (emu_preferences *)gb->direct.priv;
-  uint8_t frameskip = (pref->config.frameskip_enabled)?
-    pref->config.frameskip_amount + 1 : 1;
+  uint8_t frameskip = (gb->direct.frame_skip)? gb->direct.frame_skip_amount : 1;
 
   uint32_t ticks = (CMT_TICKS_PER_SEC / FRAME_TARGET) * frameskip;
   
@@ -24,10 +96,23 @@ void frametime_counter_set(struct gb_s *gb)
   ticks = (ticks * current_pll) / default_pll;
 
   cmt_set((ticks * 100) / speed_perc, MODE_ONE_SHOT, REQUEST_DISABLE);
+
+  // cmt_set() stops the timer, start a fresh period on the next frame
+  counter_running = false;
+
+  auto_frameskip_reset();
 }
 
 void frametime_counter_start()
 {
+  // Restarting the timer on skipped frames would let slow skipped frames
+  // stretch the period beyond its budget
+  if (counter_running)
+  {
+    return;
+  }
+
+  counter_running = true;
   cmt_start();
 }
 
@@ -39,11 +124,37 @@ void frametime_counter_wait(struct gb_s *gb)
   {
     return;
   }
+
+  if (gb->display.present != GB_PRESENT_NEW && run_ahead_frames < RUN_AHEAD_MAX)
+  {
+    run_ahead_frames++;
+    period_ran_ahead = true;
+    return;
+  }
+
+  run_ahead_frames = 0;
+  counter_running = false;
   
   if (pref->config.emulation_speed == (EMU_SPEED_MAX + EMU_SPEED_STEP))
   {
     return;
   }
 
+  // Periods with frames that ran ahead are over budget on purpose
+  bool auto_frameskip = pref->config.frameskip_enabled && pref->config.frameskip_auto 
+    && !period_ran_ahead;
+
+  period_ran_ahead = false;
+
+  if (auto_frameskip)
+  {
+    auto_frameskip_sample();
+  }
+
   cmt_wait();
+
+  if (auto_frameskip)
+  {
+    auto_frameskip_update(gb);
+  }
 }
\ No newline at end of file
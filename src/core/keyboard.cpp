@@ -0,0 +1,83 @@
+#include "keyboard.h"
+
+#include <sdk/calc/calc.hpp>
+#include <sdk/os/input.hpp>
+#include "../cas/cpu/keysc.h"
+
+static const keyboard_script_entry *script_entries = nullptr;
+static uint16_t script_length = 0;
+static uint16_t script_entry = 0;
+static uint16_t script_reads = 0;
+
+static bool keysc_backend_read(uint32_t *key1, uint32_t *key2)
+{
+  keysc_read(key1, key2);
+
+  return (*key1 | *key2) != 0;
+}
+
+static bool os_backend_read(uint32_t *key1, uint32_t *key2)
+{
+  // The key words may hold stale bits if no key is down
+  if (!Input_IsAnyKeyDown())
+  {
+    *key1 = 0;
+    *key2 = 0;
+    return false;
+  }
+
+  // The key words may also still be empty while a key is down
+  getKey(key1, key2);
+
+  return (*key1 | *key2) != 0;
+}
+
+static bool script_backend_read(uint32_t *key1, uint32_t *key2)
+{
+  // Skip to the entry for this read
+  while (script_entry < script_length && script_reads >= script_entries[script_entry].reads)
+  {
+    script_entry++;
+    script_reads = 0;
+  }
+
+  if (script_entry >= script_length)
+  {
+    *key1 = 0;
+    *key2 = 0;
+    return false;
+  }
+
+  script_reads++;
+
+  *key1 = script_entries[script_entry].key1;
+  *key2 = script_entries[script_entry].key2;
+
+  return (*key1 | *key2) != 0;
+}
+
+static const keyboard_backend backends[KEYBOARD_BACKEND_COUNT] = {
+  { keysc_backend_read, "Direct" },
+  { os_backend_read, "OS" },
+  { script_backend_read, "Script" },
+};
+
+const keyboard_backend *keyboard = &backends[KEYBOARD_DEFAULT_BACKEND];
+
+void keyboard_set_backend(uint8_t backend)
+{
+  if (backend >= KEYBOARD_BACKEND_COUNT)
+  {
+    backend = KEYBOARD_DEFAULT_BACKEND;
+  }
+
+  keyboard = &backends[backend];
+}
+
+void keyboard_set_script(const keyboard_script_entry *script, uint16_t length)
+{
+  script_entries = script;
+  script_length = length;
+  script_entry = 0;
+  script_reads = 0;
+}
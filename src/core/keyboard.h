@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#define KEYBOARD_BACKEND_KEYSC  0 // Reads the key scan registers directly
+#define KEYBOARD_BACKEND_OS     1 // Uses the OS calls, as a fallback
+#define KEYBOARD_BACKEND_SCRIPT 2 // Replays scripted key states
+#define KEYBOARD_BACKEND_COUNT  3
+
+#ifndef KEYBOARD_DEFAULT_BACKEND
+# ifdef __sh__
+#  define KEYBOARD_DEFAULT_BACKEND KEYBOARD_BACKEND_KEYSC
+# else
+#  define KEYBOARD_DEFAULT_BACKEND KEYBOARD_BACKEND_SCRIPT
+# endif
+#endif
+
+// Key state returned by the script backend for the given amount of reads
+typedef struct
+{
+  uint32_t key1;
+  uint32_t key2;
+  uint16_t reads;
+} keyboard_script_entry;
+
+typedef struct
+{
+  // Reads both key words, returns false if no key is pressed
+  bool (*read)(uint32_t *key1, uint32_t *key2);
+  const char *name;
+} keyboard_backend;
+
+extern const keyboard_backend *keyboard;
+
+void keyboard_set_backend(uint8_t backend);
+
+// Script replayed by the script backend, no key is pressed once it ended
+void keyboard_set_script(const keyboard_script_entry *script, uint16_t length);
+
+inline bool keyboard_read(uint32_t *key1, uint32_t *key2)
+{
+  return keyboard->read(key1, key2);
+}
@@ -0,0 +1,153 @@
+#include "latency.h"
+
+#include "../cas/cpu/dmac.h"
+#include "../cas/cpu/tmu.h"
+
+static bool enabled = false;
+
+// Samples in tenths of a millisecond, kept as ring buffers
+static uint16_t samples[LATENCY_SERIES][LATENCY_SAMPLES];
+static uint8_t sample_count[LATENCY_SERIES];
+static uint8_t sample_next[LATENCY_SERIES];
+
+// Time the measured key change was sampled
+static uint32_t key_time;
+static bool lcd_pending = false;
+static bool dma_pending = false;
+
+// Hash of every line last sent to the LCD, to find the first changed one
+static uint32_t line_hash[LCD_HEIGHT];
+
+static void add_sample(uint8_t series)
+{
+  uint32_t value = tmu_ticks_to_tenth_ms(tmu_clock() - key_time);
+
+  samples[series][sample_next[series]] = (value > 0xFFFF)? 0xFFFF : value;
+  sample_next[series] = (sample_next[series] + 1) % LATENCY_SAMPLES;
+
+  if (sample_count[series] < LATENCY_SAMPLES)
+  {
+    sample_count[series]++;
+  }
+}
+
+static void latency_joypad_read(struct gb_s *gb)
+{
+  (void)gb;
+
+  add_sample(LATENCY_JOYP);
+  lcd_pending = true;
+}
+
+void latency_enable(struct gb_s *gb, bool enable)
+{
+  enabled = enable;
+  lcd_pending = false;
+  dma_pending = false;
+  gb->direct.joypad_watch = 0;
+
+  if (!enable)
+  {
+    gb->gb_joypad_read = nullptr;
+    return;
+  }
+
+  for (uint8_t i = 0; i < LATENCY_SERIES; i++)
+  {
+    sample_count[i] = 0;
+    sample_next[i] = 0;
+  }
+
+  for (uint8_t i = 0; i < LCD_HEIGHT; i++)
+  {
+    line_hash[i] = 0;
+  }
+
+  gb->gb_joypad_read = latency_joypad_read;
+  tmu_start_clock();
+}
+
+bool latency_enabled()
+{
+  return enabled;
+}
+
+void latency_input(struct gb_s *gb, uint8_t previous_joypad)
+{
+  uint8_t changed = previous_joypad ^ gb->direct.joypad;
+
+  // Only one key change is measured at a time
+  if (!enabled || !changed || gb->direct.joypad_watch || lcd_pending || dma_pending)
+  {
+    return;
+  }
+
+  key_time = tmu_clock();
+  gb->direct.joypad_watch = changed;
+}
+
+void latency_line(const uint32_t *pixels, uint8_t line)
+{
+  uint32_t hash = 0;
+
+  for (uint8_t i = 0; i < LCD_WIDTH; i++)
+  {
+    hash = ((hash << 5) | (hash >> 27)) ^ pixels[i];
+  }
+
+  // The line is on screen once its transfer completed
+  if (lcd_pending && hash != line_hash[line])
+  {
+    lcd_pending = false;
+    dma_pending = true;
+  }
+
+  line_hash[line] = hash;
+}
+
+void latency_dma_done()
+{
+  if (!dma_pending)
+  {
+    return;
+  }
+
+  dma_pending = false;
+  add_sample(LATENCY_LCD);
+}
+
+void latency_frame_done()
+{
+  if (!dma_pending)
+  {
+    return;
+  }
+
+  dma_wait(DMAC_CHCR_0);
+  latency_dma_done();
+}
+
+void latency_get_stats(uint8_t series, latency_stats *stats)
+{
+  uint16_t sorted[LATENCY_SAMPLES];
+  uint8_t count = sample_count[series];
+
+  // Insertion sort, there are only a few samples
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint16_t value = samples[series][i];
+    uint8_t j = i;
+
+    for (; j > 0 && sorted[j - 1] > value; j--)
+    {
+      sorted[j] = sorted[j - 1];
+    }
+
+    sorted[j] = value;
+  }
+
+  stats->count = count;
+  stats->p50 = (count)? sorted[((count - 1) * 50) / 100] : 0;
+  stats->p90 = (count)? sorted[((count - 1) * 90) / 100] : 0;
+  stats->p99 = (count)? sorted[((count - 1) * 99) / 100] : 0;
+}
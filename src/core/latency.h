@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "peanut_gb_header.h"
+
+#define LATENCY_SAMPLES 64
+
+// Key press until the game reads it from JOYP
+#define LATENCY_JOYP    0
+// Key press until the first changed line reached the LCD
+#define LATENCY_LCD     1
+#define LATENCY_SERIES  2
+
+// Percentiles in tenths of a millisecond
+typedef struct 
+{
+  uint16_t p50;
+  uint16_t p90;
+  uint16_t p99;
+  uint8_t count;
+} latency_stats;
+
+void latency_enable(struct gb_s *gb, bool enable);
+
+bool latency_enabled();
+
+void latency_input(struct gb_s *gb, uint8_t previous_joypad);
+
+void latency_line(const uint32_t *pixels, uint8_t line);
+
+void latency_dma_done();
+
+void latency_frame_done();
+
+void latency_get_stats(uint8_t series, latency_stats *stats);
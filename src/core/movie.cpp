@@ -0,0 +1,502 @@
+#include "movie.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sdk/os/file.hpp>
+#include "cart_ram.h"
+#include "emulator.h"
+#include "error.h"
+#include "savestate.h"
+#include "../helpers/fileio.h"
+#include "../helpers/functions.h"
+#include "../helpers/macros.h"
+
+// Movies start with this header, followed by records. All values are 
+// little endian, so movies can be read on any platform.
+#define MOVIE_MAGIC       "CPBM"
+#define MOVIE_VERSION     1
+#define MOVIE_HEADER_SIZE 16
+
+// Joypad state and the frames it is held for
+#define MOVIE_TAG_INPUT   0x00
+#define MOVIE_TAG_INPUT_SIZE 4
+// Checksum of the emulated memory after every MOVIE_CHECK_INTERVAL frames
+#define MOVIE_TAG_CHECK   0x01
+#define MOVIE_TAG_CHECK_SIZE 5
+#define MOVIE_TAG_END     0xFF
+
+#define MOVIE_RUN_MAX     0xFFFF
+
+// Records are collected here and written once it is full
+#define MOVIE_BUFFER_SIZE 1024
+
+static uint8_t state = MOVIE_IDLE;
+static uint32_t frames = 0;
+static uint32_t total_frames = 0;
+static uint16_t mismatches = 0;
+static uint32_t first_mismatch = 0;
+
+// Recording
+static int32_t movie_fd = -1;
+static uint8_t buffer[MOVIE_BUFFER_SIZE];
+static uint16_t buffer_len = 0;
+static uint8_t run_joypad = 0xFF;
+static uint16_t run_frames = 0;
+
+// Replay, the whole movie is read at once
+static uint8_t *movie = nullptr;
+static uint32_t movie_len = 0;
+static uint32_t movie_pos = 0;
+
+static void put_le16(uint8_t *buf, uint16_t value)
+{
+  buf[0] = value & 0xFF;
+  buf[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *buf, uint32_t value)
+{
+  put_le16(buf, value & 0xFFFF);
+  put_le16(buf + 2, value >> 16);
+}
+
+static uint16_t read_le16(const uint8_t *buf)
+{
+  return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t read_le32(const uint8_t *buf)
+{
+  return read_le16(buf) | ((uint32_t)read_le16(buf + 2) << 16);
+}
+
+static void get_movie_path(struct gb_s *gb, char *path_buffer, size_t len)
+{
+  get_state_path((emu_preferences *)gb->direct.priv, EXTENSION_MOVIE, path_buffer, len);
+}
+
+static void get_start_path(struct gb_s *gb, char *path_buffer, size_t len)
+{
+  get_state_path((emu_preferences *)gb->direct.priv, EXTENSION_MOVIE_START, path_buffer, len);
+}
+
+static void fill_header(struct gb_s *gb, uint8_t *header, uint8_t start)
+{
+  memcpy(header, MOVIE_MAGIC, 4);
+  put_le16(header + 4, MOVIE_VERSION);
+  header[6] = start;
+  header[7] = MOVIE_CHECK_INTERVAL;
+  header[8] = gb->rom[ROM_HEADER_CHECKSUM_LOC + 1];
+  header[9] = gb->rom[ROM_HEADER_CHECKSUM_LOC + 2];
+  header[10] = gb->rom[ROM_HEADER_CHECKSUM_LOC];
+  header[11] = 0;
+  put_le32(header + 12, frames);
+}
+
+// FNV-1a over the emulated memory. Only byte arrays are hashed, so the 
+// checksum is the same on every platform.
+static uint32_t memory_checksum(struct gb_s *gb)
+{
+  const uint8_t *areas[] = { gb->wram, gb->vram, gb->oam, gb->hram_io };
+  const uint32_t sizes[] = { WRAM_SIZE, VRAM_SIZE, OAM_SIZE, HRAM_IO_SIZE };
+  uint32_t hash = 2166136261U;
+
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    for (uint32_t j = 0; j < sizes[i]; j++)
+    {
+      hash = (hash ^ areas[i][j]) * 16777619U;
+    }
+  }
+
+  return hash;
+}
+
+static uint8_t flush_buffer()
+{
+  if (buffer_len == 0)
+  {
+    return 0;
+  }
+
+  if (write(movie_fd, buffer, buffer_len) != buffer_len)
+  {
+    return 1;
+  }
+
+  buffer_len = 0;
+
+  return 0;
+}
+
+static uint8_t put_record(const uint8_t *record, uint8_t len)
+{
+  if (buffer_len + len > MOVIE_BUFFER_SIZE && flush_buffer())
+  {
+    return 1;
+  }
+
+  memcpy(buffer + buffer_len, record, len);
+  buffer_len += len;
+
+  return 0;
+}
+
+static uint8_t put_run()
+{
+  uint8_t record[MOVIE_TAG_INPUT_SIZE] = { MOVIE_TAG_INPUT, run_joypad };
+
+  if (run_frames == 0)
+  {
+    return 0;
+  }
+
+  put_le16(record + 2, run_frames);
+  run_frames = 0;
+
+  return put_record(record, sizeof(record));
+}
+
+// Stops recording or replaying after a write or read error
+static void movie_fail(struct gb_s *gb)
+{
+  char path[MAX_FILENAME_LEN];
+  char err_info[ERROR_MAX_INFO_LEN];
+  const uint8_t error = (state == MOVIE_RECORDING)? EFWRITE : EFREAD;
+
+  get_movie_path(gb, path, sizeof(path));
+  strlcpy(err_info, "movie: ", sizeof(err_info));
+  strlcat(err_info, path, sizeof(err_info));
+
+  movie_stop(gb);
+  set_error_i(error, err_info);
+}
+
+uint8_t movie_record(struct gb_s *gb, uint8_t start)
+{
+  char path[MAX_FILENAME_LEN];
+  char err_info[ERROR_MAX_INFO_LEN];
+  uint8_t header[MOVIE_HEADER_SIZE];
+
+  movie_stop(gb);
+
+  if (start == MOVIE_START_RESET)
+  {
+    gb_reset(gb);
+  }
+
+  // The starting state is a state file next to the movie
+  get_start_path(gb, path, sizeof(path));
+
+  if (write_state_file(gb, path))
+  {
+    return 1;
+  }
+
+  get_movie_path(gb, path, sizeof(path));
+  strlcpy(err_info, "w: ", sizeof(err_info));
+  strlcat(err_info, path, sizeof(err_info));
+
+  // Start a new file, the frame count is filled in once recording stops
+  if (file_exists(path))
+  {
+    delete_file(path);
+  }
+
+  movie_fd = open(path, OPEN_WRITE | OPEN_CREATE);
+
+  if (movie_fd < 0)
+  {
+    set_error_i(EFOPEN, err_info);
+    return 1;
+  }
+
+  frames = 0;
+  fill_header(gb, header, start);
+
+  if (write(movie_fd, header, sizeof(header)) != sizeof(header))
+  {
+    close(movie_fd);
+    movie_fd = -1;
+    set_error_i(EFWRITE, err_info);
+    return 1;
+  }
+
+  buffer_len = 0;
+  run_frames = 0;
+  state = MOVIE_RECORDING;
+
+  // The joypad may only change between frames
+  set_lazy_input(gb, ((emu_preferences *)gb->direct.priv)->config.lazy_input);
+
+  return 0;
+}
+
+uint8_t movie_replay(struct gb_s *gb)
+{
+  char path[MAX_FILENAME_LEN];
+  char err_info[ERROR_MAX_INFO_LEN];
+  uint8_t expected[MOVIE_HEADER_SIZE];
+  size_t size;
+
+  movie_stop(gb);
+
+  get_movie_path(gb, path, sizeof(path));
+  strlcpy(err_info, "r: ", sizeof(err_info));
+  strlcat(err_info, path, sizeof(err_info));
+
+  if (get_file_size(path, &size))
+  {
+    return 1;
+  }
+
+  movie = (uint8_t *)malloc(size);
+
+  if (!movie)
+  {
+    set_error(EMALLOC);
+    return 1;
+  }
+
+  if (read_file(path, movie, size))
+  {
+    free(movie);
+    movie = nullptr;
+    return 1;
+  }
+
+  // Everything but the frame count has to match
+  fill_header(gb, expected, 0);
+
+  if (
+    size < MOVIE_HEADER_SIZE 
+    || memcmp(movie, expected, 6) 
+    || memcmp(movie + 7, expected + 7, 5)
+  )
+  {
+    free(movie);
+    movie = nullptr;
+    set_error_i(ESTATE, err_info);
+    return 1;
+  }
+
+  // Save the game before the replay changes it
+  if (flush_cart_ram(gb, UINT16_MAX))
+  {
+    free(movie);
+    movie = nullptr;
+    return 1;
+  }
+
+  get_start_path(gb, path, sizeof(path));
+
+  const uint8_t read = read_state_file(gb, path);
+
+  if (read != STATE_READ_OK)
+  {
+    free(movie);
+    movie = nullptr;
+
+    // Memory is broken, start over from the save file
+    if (read == STATE_READ_BROKEN)
+    {
+      restart_broken_state(gb);
+    }
+
+    return 1;
+  }
+
+  movie_len = size;
+  movie_pos = MOVIE_HEADER_SIZE;
+  total_frames = read_le32(movie + 12);
+  frames = 0;
+  run_frames = 0;
+  mismatches = 0;
+  first_mismatch = 0;
+  state = MOVIE_REPLAYING;
+
+  set_lazy_input(gb, ((emu_preferences *)gb->direct.priv)->config.lazy_input);
+
+  return 0;
+}
+
+uint8_t movie_stop(struct gb_s *gb)
+{
+  uint8_t ret = 0;
+
+  if (state == MOVIE_RECORDING)
+  {
+    uint8_t header[MOVIE_HEADER_SIZE];
+    const uint8_t end = MOVIE_TAG_END;
+
+    ret |= put_run();
+    ret |= put_record(&end, sizeof(end));
+    ret |= flush_buffer();
+
+    // Fill in the frame count
+    fill_header(gb, header, 0);
+
+    if (lseek(movie_fd, 12, SEEK_SET) < 0 || write(movie_fd, header + 12, 4) != 4)
+    {
+      ret = 1;
+    }
+
+    ret |= (close(movie_fd) < 0);
+    movie_fd = -1;
+    total_frames = frames;
+
+    if (ret)
+    {
+      char path[MAX_FILENAME_LEN];
+      char err_info[ERROR_MAX_INFO_LEN];
+
+      get_movie_path(gb, path, sizeof(path));
+      strlcpy(err_info, "w: ", sizeof(err_info));
+      strlcat(err_info, path, sizeof(err_info));
+      set_error_i(EFWRITE, err_info);
+    }
+  }
+
+  free(movie);
+  movie = nullptr;
+
+  // A replayed game keeps holding its saves until the rom is closed
+  state = (state >= MOVIE_REPLAYING)? MOVIE_REPLAY_DONE : MOVIE_IDLE;
+
+  set_lazy_input(gb, ((emu_preferences *)gb->direct.priv)->config.lazy_input);
+
+  return ret;
+}
+
+bool movie_exists(emu_preferences *preferences)
+{
+  char path[MAX_FILENAME_LEN];
+
+  return file_exists(get_state_path(preferences, EXTENSION_MOVIE, path, sizeof(path)));
+}
+
+uint8_t movie_state()
+{
+  return state;
+}
+
+void movie_frame(struct gb_s *gb)
+{
+  if (state == MOVIE_RECORDING)
+  {
+    if (run_frames > 0 && (gb->direct.joypad != run_joypad || run_frames == MOVIE_RUN_MAX))
+    {
+      if (put_run())
+      {
+        movie_fail(gb);
+        return;
+      }
+    }
+
+    run_joypad = gb->direct.joypad;
+    run_frames++;
+    return;
+  }
+
+  if (state != MOVIE_REPLAYING)
+  {
+    return;
+  }
+
+  // Read the next input run once the last one ran out
+  while (run_frames == 0)
+  {
+    if (movie_pos >= movie_len || movie[movie_pos] == MOVIE_TAG_END)
+    {
+      movie_stop(gb);
+      return;
+    }
+
+    if (
+      movie[movie_pos] != MOVIE_TAG_INPUT 
+      || movie_len - movie_pos < MOVIE_TAG_INPUT_SIZE
+    )
+    {
+      movie_fail(gb);
+      return;
+    }
+
+    run_joypad = movie[movie_pos + 1];
+    run_frames = read_le16(movie + movie_pos + 2);
+    movie_pos += MOVIE_TAG_INPUT_SIZE;
+  }
+
+  gb->direct.joypad = run_joypad;
+  run_frames--;
+}
+
+void movie_frame_done(struct gb_s *gb)
+{
+  uint8_t record[MOVIE_TAG_CHECK_SIZE] = { MOVIE_TAG_CHECK };
+
+  if (!movie_active())
+  {
+    return;
+  }
+
+  if (++frames % MOVIE_CHECK_INTERVAL != 0)
+  {
+    return;
+  }
+
+  const uint32_t checksum = memory_checksum(gb);
+
+  if (state == MOVIE_RECORDING)
+  {
+    // The run before the checksum ends here, so a replay finds the 
+    // checksum right after the input it checks
+    put_le32(record + 1, checksum);
+
+    if (put_run() || put_record(record, sizeof(record)))
+    {
+      movie_fail(gb);
+    }
+
+    return;
+  }
+
+  if (
+    run_frames != 0 
+    || movie_len - movie_pos < MOVIE_TAG_CHECK_SIZE
+    || movie[movie_pos] != MOVIE_TAG_CHECK
+  )
+  {
+    movie_fail(gb);
+    return;
+  }
+
+  if (read_le32(movie + movie_pos + 1) != checksum)
+  {
+    if (mismatches == 0)
+    {
+      first_mismatch = frames;
+    }
+
+    if (mismatches < UINT16_MAX)
+    {
+      mismatches++;
+    }
+  }
+
+  movie_pos += MOVIE_TAG_CHECK_SIZE;
+}
+
+void movie_get_info(movie_info *info)
+{
+  info->state = state;
+  info->frames = frames;
+  info->total_frames = total_frames;
+  info->mismatches = mismatches;
+  info->first_mismatch = first_mismatch;
+}
+
+void movie_close(struct gb_s *gb)
+{
+  movie_stop(gb);
+  state = MOVIE_IDLE;
+}
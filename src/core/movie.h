@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include "peanut_gb_header.h"
+#include "preferences.h"
+
+// Where a recording starts from. Both store the starting state next to 
+// the movie, a reset only resets the emulator before it is taken.
+#define MOVIE_START_RESET 0
+#define MOVIE_START_STATE 1
+
+#define MOVIE_IDLE        0
+#define MOVIE_RECORDING   1
+#define MOVIE_REPLAYING   2
+// The replay finished, the game is played normally again
+#define MOVIE_REPLAY_DONE 3
+
+// Frames between two checksums of the emulated memory
+#define MOVIE_CHECK_INTERVAL 60
+
+typedef struct
+{
+  uint8_t state;
+  // Frames recorded or replayed so far, and of the whole movie
+  uint32_t frames;
+  uint32_t total_frames;
+  // Checksums that did not match during replay, and the first frame one
+  // did not match at
+  uint16_t mismatches;
+  uint32_t first_mismatch;
+} movie_info;
+
+/**
+ * Starts recording the joypad to the movie of the current rom. 
+ * 
+ * @param start MOVIE_START_RESET or MOVIE_START_STATE
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t movie_record(struct gb_s *gb, uint8_t start);
+
+/**
+ * Restores the starting state of the movie of the current rom and replays
+ * its input from the next frame on. 
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t movie_replay(struct gb_s *gb);
+
+// Finishes the recording or stops the replay
+uint8_t movie_stop(struct gb_s *gb);
+
+bool movie_exists(emu_preferences *preferences);
+
+uint8_t movie_state();
+
+inline bool movie_active()
+{
+  return movie_state() == MOVIE_RECORDING || movie_state() == MOVIE_REPLAYING;
+}
+
+// Cart RAM must not be saved while a replayed game may have changed it
+inline bool movie_holds_saves()
+{
+  return movie_state() >= MOVIE_REPLAYING;
+}
+
+// Records or replaces the joypad state, call before every frame
+void movie_frame(struct gb_s *gb);
+
+// Records or checks the memory checksum, call after every frame
+void movie_frame_done(struct gb_s *gb);
+
+void movie_get_info(movie_info *info);
+
+// Stops the movie and lets the next rom save again
+void movie_close(struct gb_s *gb);
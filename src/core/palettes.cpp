@@ -1,5 +1,6 @@
 #include "palettes.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +8,8 @@
 #include <sdk/os/debug.hpp>
 #include "error.h"
 #include "emulator.h"
+#include "pref_store.h"
+#include "../helpers/arena.h"
 #include "../helpers/fileio.h"
 #include "../helpers/functions.h"
 #include "../helpers/ini.h"
@@ -217,220 +220,202 @@ char *generate_palette_name(char *str_buffer, struct gb_s *gb)
   return str_buffer;
 }
 
-uint8_t process_palette_ini(char *ini_string, uint32_t len, palette *pal)
+// Every color is stored as "<palette>_<color>"
+#define PALETTE_COLOR_BIND(p, c) \
+  { \
+    PALETTE_INI_SECTION_NAME, #p "_" #c, INI_FIELD_U16, \
+    offsetof(palette, data) + ((p) * 4 + (c)) * sizeof(uint16_t), sizeof(uint16_t) \
+  }
+
+static const ini_binding palette_bindings[] = 
 {
-  ini_file file;
-  ini_parse(ini_string, len, &file);
+  INI_BIND(PALETTE_INI_SECTION_NAME, PALETTE_INI_NAME_KEY, INI_FIELD_STR, palette, name),
+  PALETTE_COLOR_BIND(0, 0), PALETTE_COLOR_BIND(0, 1), PALETTE_COLOR_BIND(0, 2), PALETTE_COLOR_BIND(0, 3),
+  PALETTE_COLOR_BIND(1, 0), PALETTE_COLOR_BIND(1, 1), PALETTE_COLOR_BIND(1, 2), PALETTE_COLOR_BIND(1, 3),
+  PALETTE_COLOR_BIND(2, 0), PALETTE_COLOR_BIND(2, 1), PALETTE_COLOR_BIND(2, 2), PALETTE_COLOR_BIND(2, 3),
+};
 
-  ini_section *section = find_section(&file, PALETTE_INI_SECTION_NAME);
+#define PALETTE_BINDING_COUNT (sizeof(palette_bindings) / sizeof(palette_bindings[0]))
 
-  if (!section)
-  {
-    free_ini_file(&file);
-    return 1;
-  }
+static const ini_binding palette_config_bindings[] = 
+{
+  { PALETTE_CONF_INI_SECTION_NAME, PALETTE_CONF_INI_COUNT_KEY, INI_FIELD_U8, 0, sizeof(uint8_t) },
+};
+
+uint8_t process_palette_ini(char *ini_string, uint32_t len, palette *pal)
+{
+  uint32_t found = ini_read_bindings(ini_string, len, palette_bindings, 
+    PALETTE_BINDING_COUNT, pal);
 
-  ini_key *name = find_key(section, PALETTE_INI_NAME_KEY);
-      
-  if (!name) 
+  // The name and all colors have to be set
+  if (found != (1 << PALETTE_BINDING_COUNT) - 1)
   {
-    free_ini_file(&file);
     return 1;
   }
-
-  strcpy(pal->name, name->value_str);
   
-  // Get all colors
-  for (uint8_t p = 0; p < 3; p++) 
-  {
-    for (uint8_t c = 0; c < 4; c++) 
-    {
-      char a = '0' + p;
-      char b = '0' + c;
-
-      const char key_name[4] = { a, PALETTE_INI_KEY_SEPERATOR, b, '\0' };
+  return 0;
+}
 
-      ini_key *color = find_key(section, key_name);
-      
-      if (!color) 
-      {
-        free_ini_file(&file);
-        return 1;
-      }
+char *create_palette_ini(palette *pal, char *ini_string, uint32_t len)
+{
+  return ini_write_bindings(palette_bindings, PALETTE_BINDING_COUNT, pal, 
+    ini_string, len);
+}
 
-      pal->data[p][c] = color->value_int;
-    }
+uint8_t process_palette_config_ini(char *ini_string, uint32_t len, uint8_t *count)
+{
+  if (!ini_read_bindings(ini_string, len, palette_config_bindings, 1, count))
+  {
+    return 1;
   }
-
-  free_ini_file(&file);
   
   return 0;
 }
 
-char *create_palette_ini(palette *pal, char *ini_string, uint32_t len)
+char *create_palette_config_ini(uint8_t count, char *ini_string, uint32_t len)
 {
-  ini_file file;
-  file.section_count = 0;
-  file.sections_size = 0;
-  
-  ini_section *palette_section = add_section(&file, PALETTE_INI_SECTION_NAME);
-  
-  if (!palette_section)
+  return ini_write_bindings(palette_config_bindings, 1, &count, ini_string, len);
+}
+
+uint8_t import_palettes_ini(palette *pals, uint8_t *count)
+{
+  uint32_t var_size;
+  uint8_t pal_count;
+  char *ini_string;
+
+  if (read_mcs(MCS_DIRECTORY, PALETTE_CONF_VAR_NAME, (void **)&ini_string, &var_size))
   {
-    return nullptr;
+    return 1;
   }
 
-  if (!add_key(
-    palette_section,
-    PALETTE_INI_NAME_KEY,
-    INI_TYPE_STRING,
-    0,
-    pal->name
-  ))
+  if (process_palette_config_ini(ini_string, var_size, &pal_count))
   {
-    free_ini_file(&file);
-    return nullptr;
+    return 1;
   }
 
-  // Setup palette data
-  for (uint8_t p = 0; p < 3; p++)
+  if (pal_count > MAX_PALETTE_COUNT)
   {
-    for (uint8_t c = 0; c < 4; c++)
+    pal_count = MAX_PALETTE_COUNT;
+  }
+
+  for (uint8_t i = 0; i < pal_count; i++)
+  {
+    char tmp[3];
+    char var_name[sizeof(PALETTE_VAR_CONSTANT) + 2] = PALETTE_VAR_CONSTANT;
+    
+    strlcat(var_name, itoa(i, tmp, 16), sizeof(var_name));
+
+    if (read_mcs(MCS_DIRECTORY, var_name, (void **)&ini_string, &var_size))
     {
-      char a = '0' + p;
-      char b = '0' + c;
-
-      const char key_name[] = { a, PALETTE_INI_KEY_SEPERATOR, b, '\0' };
-      
-      if (!add_key(
-        palette_section,
-        key_name,
-        INI_TYPE_INT,
-        pal->data[p][c]
-      ))
-      {
-        free_ini_file(&file);
-        return nullptr;
-      }
+      return 1;
+    }
+
+    if (process_palette_ini(ini_string, var_size, &(pals[i]))) 
+    {
+      return 1;
     }
   }
 
-  ini_write(&file, ini_string, len);
-  free_ini_file(&file);
+  *count = pal_count;
 
-  return ini_string;
+  return 0;
 }
 
-uint8_t process_palette_config_ini(char *ini_string, uint32_t len, uint8_t *count)
+uint8_t export_palettes_ini(palette *pals, uint8_t count)
 {
-  ini_file file;
-  ini_parse(ini_string, len, &file);
-
-  ini_section *section = find_section(&file, PALETTE_CONF_INI_SECTION_NAME);
+  char ini_string[INI_MAX_CONTENT_LEN];
 
-  if (!section)
+  for (uint8_t i = 0; i < count; i++)
   {
-    free_ini_file(&file);
-    return 1;
+    if (!create_palette_ini(&(pals[i]), ini_string, sizeof(ini_string)))
+    {
+      return 1;
+    }
+
+    uint32_t size = align_val(strlen(ini_string), 4);
+
+    char tmp[3];
+    char var_name[sizeof(tmp) + sizeof(PALETTE_VAR_CONSTANT) - 1] = PALETTE_VAR_CONSTANT;
+    
+    strlcat(var_name, itoa(i, tmp, 16), sizeof(var_name));
+
+    if (write_mcs(MCS_DIRECTORY, var_name, ini_string, size) != 0)
+    {
+      return 1;
+    }
   }
 
-  ini_key *pal_count = find_key(section, PALETTE_CONF_INI_COUNT_KEY);
-      
-  if (!pal_count) 
+  if (!create_palette_config_ini(count, ini_string, sizeof(ini_string)))
   {
-    free_ini_file(&file);
     return 1;
   }
 
-  *count = pal_count->value_int;
+  // Get 4 aligned size for mcs variable
+  uint32_t size = align_val(strlen(ini_string), 4);
 
-  free_ini_file(&file);
-  
-  return 0;
+  return write_mcs(MCS_DIRECTORY, PALETTE_CONF_VAR_NAME, ini_string, size);
 }
 
-char *create_palette_config_ini(uint8_t count, char *ini_string, uint32_t len)
+uint8_t load_user_palettes(palette *pals, uint8_t *count)
 {
-  ini_file file;
-  file.section_count = 0;
-  file.sections_size = 0;
-  
-  ini_section *pal_config_section = add_section(&file, PALETTE_CONF_INI_SECTION_NAME);
-  
-  if (!pal_config_section)
-  {
-    free_ini_file(&file);
-    return nullptr;
-  }
+  uint16_t pal_count;
 
-  if (!add_key(
-    pal_config_section, 
-    PALETTE_CONF_INI_COUNT_KEY,
-    INI_TYPE_INT,
-    count
-  ))
+  if (pref_store_read(PREF_STORE_PALETTES, pals, sizeof(palette), MAX_PALETTE_COUNT, 
+    &pal_count) == 0)
   {
-    free_ini_file(&file);
-    return nullptr;
+    *count = pal_count;
+    return 0;
   }
-  
-  ini_write(&file, ini_string, len);
-  free_ini_file(&file);
-
-  return ini_string;
-}
 
-uint8_t save_palette_config(uint8_t pal_count)
-{
-  char ini_string[INI_MAX_CONTENT_LEN];
-
-  if (!create_palette_config_ini(pal_count, ini_string, sizeof(ini_string)))
+  // A rejected store is left alone until the user has been told about it
+  if (errno == EPREFS)
   {
+    *count = 0;
     return 1;
   }
 
-  // Get 4 aligned size for mcs variable
-  uint32_t size = align_val(strlen(ini_string), 4);
-
-  if (write_mcs(MCS_DIRECTORY, PALETTE_CONF_VAR_NAME, ini_string, size))
+  // Take over the ini files of an older version once. Without them there
+  // are no user palettes yet, which is stored as well.
+  if (import_palettes_ini(pals, count))
   {
-    return 1;
+    *count = 0;
   }
 
-  return 0;
+  return save_user_palettes(pals, *count);
+}
+
+uint8_t save_user_palettes(palette *pals, uint8_t count)
+{
+  return pref_store_write(PREF_STORE_PALETTES, pals, sizeof(palette), count);
 }
 
 uint8_t create_palette(struct gb_s *gb) 
 {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
  
-  palette new_pal;
+  palette *new_pal;
   uint16_t default_palette[3][4] = DEFAULT_PALETTE;
-  uint8_t user_palette_count = get_user_palettes(nullptr, gb);
  
   // Check if already reached max palette count
-  if (user_palette_count == MAX_PALETTE_COUNT) 
+  if (preferences->stored_palette_count == MAX_PALETTE_COUNT) 
   {
     return ERR_MAX_PALETTE_REACHED;
   }
 
-  generate_palette_name(new_pal.name, gb);
-  memcpy(new_pal.data, default_palette, sizeof(default_palette));
+  new_pal = &(preferences->stored_palettes[preferences->stored_palette_count]);
 
-  // Save newly created palette
-  if (save_palette(&new_pal, user_palette_count))
-  {
-    return 1;
-  }
+  generate_palette_name(new_pal->name, gb);
+  memcpy(new_pal->data, default_palette, sizeof(default_palette));
+
+  preferences->stored_palette_count++;
 
-  // Save new palette config
-  if (save_palette_config(user_palette_count + 1))
+  // Save newly created palette
+  if (save_user_palettes(preferences->stored_palettes, preferences->stored_palette_count))
   {
     return 1;
   }
 
   // Reload palettes
-  free(preferences->palettes);
   load_palettes(gb);
 
   return 0;
@@ -439,40 +424,26 @@ uint8_t create_palette(struct gb_s *gb)
 uint8_t delete_palette(struct gb_s *gb, uint8_t index) 
 {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
-  palette *user_palettes = nullptr;
-  uint8_t user_palette_count = get_user_palettes(&user_palettes, gb);
+  palette *stored = preferences->stored_palettes;
 
-  // Overwrite palette in palette array and move everything to the front
-  for (uint8_t i = index; i < (user_palette_count - 1); i++) 
-  {
-    memcpy(&(user_palettes[i]), &(user_palettes[i + 1]), sizeof(palette));
-    save_palette(&(user_palettes[i]), i);
-  }
+  // Move everything behind the palette to the front
+  memmove(&(stored[index]), &(stored[index + 1]), 
+    (preferences->stored_palette_count - index - 1) * sizeof(palette));
 
   // Reduce total palette count
-  preferences->palette_count--;
+  preferences->stored_palette_count--;
 
-  save_palette_config(user_palette_count - 1);
+  save_user_palettes(stored, preferences->stored_palette_count);
 
-  return 0;
+  return load_palettes(gb);
 }
 
 uint8_t load_palettes(struct gb_s *gb)
 {
   emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
 
-  uint32_t var_size;
-  uint8_t user_palette_count = 0;
-  char *ini_string;
-
-  // Try to load palette config
-  if (read_mcs(MCS_DIRECTORY, PALETTE_CONF_VAR_NAME, (void **)&ini_string, &var_size) == 0)
-  {
-    if (process_palette_config_ini(ini_string, var_size, &user_palette_count))
-    {
-      return 1;
-    }
-  }
+  // The user palettes were loaded at startup
+  uint8_t user_palette_count = preferences->stored_palette_count;
   
   // Get game palette
 	uint16_t game_palette[3][4];
@@ -480,15 +451,22 @@ uint8_t load_palettes(struct gb_s *gb)
   bool has_game_palette = get_game_palette(gb_colour_hash(gb), game_palette);
 
   preferences->palette_count = 1 + has_game_palette + user_palette_count;
-  preferences->palettes = (palette *)malloc(preferences->palette_count * sizeof(palette));
 
-  // Check if malloc failed
+  // Room for the most palettes there can be, so reloading them after a 
+  // palette was created keeps the memory of the rom
+  if (!preferences->palettes)
+  {
+    preferences->palettes = (palette *)arena_alloc(&rom_arena, 
+      (2 + MAX_PALETTE_COUNT) * sizeof(palette));
+  }
+
+  // Check if the allocation failed
   if (!(preferences->palettes))
   {
     char tmp[10];
     char err_info[ERROR_MAX_INFO_LEN];
     strlcpy(err_info, "Palettes: ", sizeof(err_info));
-    strlcat(err_info, itoa(preferences->palette_count, tmp, 10), sizeof(err_info));
+    strlcat(err_info, itoa((2 + MAX_PALETTE_COUNT) * sizeof(palette), tmp, 10), sizeof(err_info));
     strlcat(err_info, "B", sizeof(err_info));
 
     set_error_i(EMALLOC, err_info);
@@ -508,49 +486,19 @@ uint8_t load_palettes(struct gb_s *gb)
   }
 
   // Set user palettes
-  for (uint8_t i = 0; i < user_palette_count; i++)
-  {
-    char tmp[3];
-    char var_name[sizeof(PALETTE_VAR_CONSTANT) + 2] = PALETTE_VAR_CONSTANT;
-    
-    strlcat(var_name, itoa(i, tmp, 16), sizeof(var_name));
-
-    if (read_mcs(MCS_DIRECTORY, var_name, (void **)&ini_string, &var_size))
-    {
-      return 1;
-    }
-
-    if (process_palette_ini(ini_string, var_size, &(preferences->palettes[1 + has_game_palette + i]))) 
-    {
-      return 1;
-    }
-  }
+  memcpy(&(preferences->palettes[1 + has_game_palette]), preferences->stored_palettes, 
+    user_palette_count * sizeof(palette));
 
   return 0;
 }
 
-uint8_t save_palette(palette *pal, uint8_t index)
+uint8_t save_palette(struct gb_s *gb, palette *pal, uint8_t index)
 {
-  char ini_string[INI_MAX_CONTENT_LEN];
-
-  if (!create_palette_ini(pal, ini_string, sizeof(ini_string)))
-  {
-    return 1;
-  }
-
-  uint32_t size = align_val(strlen(ini_string), 4);
-
-  char tmp[3];
-  char var_name[sizeof(tmp) + sizeof(PALETTE_VAR_CONSTANT) - 1] = PALETTE_VAR_CONSTANT;
-  
-  strlcat(var_name, itoa(index, tmp, 16), sizeof(var_name));
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
-  if (write_mcs(MCS_DIRECTORY, var_name, ini_string, size) != 0)
-  {
-    return 1;
-  }
+  memcpy(&(preferences->stored_palettes[index]), pal, sizeof(palette));
 
-  return 0;
+  return save_user_palettes(preferences->stored_palettes, preferences->stored_palette_count);
 }
 
 uint8_t get_user_palettes(palette **pal, struct gb_s *gb)
@@ -28,6 +28,16 @@ uint8_t delete_palette(struct gb_s *gb, uint8_t index);
 
 uint8_t load_palettes(struct gb_s *gb);
 
-uint8_t save_palette(palette *pal, uint8_t index);
+uint8_t save_palette(struct gb_s *gb, palette *pal, uint8_t index);
+
+// The user palettes are loaded once from the binary store
+uint8_t load_user_palettes(palette *pals, uint8_t *count);
+
+uint8_t save_user_palettes(palette *pals, uint8_t count);
+
+// The ini files are only used to export or import the user palettes
+uint8_t import_palettes_ini(palette *pals, uint8_t *count);
+
+uint8_t export_palettes_ini(palette *pals, uint8_t count);
 
 uint8_t get_user_palettes(palette **pal, struct gb_s *gb);
\ No newline at end of file
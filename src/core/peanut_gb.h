@@ -417,16 +417,204 @@
 /* Two pixel arrays for double buffering */
 uint32_t lcd_pixels[2][LCD_WIDTH] __attribute__((section(".oc_mem.y.data")));
 
+/* Indexes into display.palette_lut, matching the layout of palette.data */
+#define LCD_LUT_OBJ0	0
+#define LCD_LUT_OBJ1	1
+#define LCD_LUT_BG	2
+
+/* Refreshes one DMG colour lookup table from its shades register and the
+ * selected colour palette. */
+void __gb_update_palette_lut(struct gb_s *gb, uint8_t table)
+{
+	emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+	const uint8_t *shades;
+	uint8_t selected;
+
+	/* gb_reset() writes BGP/OBP before the front-end loaded its palettes.
+	 * gb_update_palette_lut() is called again once they are available. */
+	if(preferences == NULL || preferences->palettes == NULL)
+		return;
+
+	selected = preferences->config.selected_palette;
+
+	if(selected >= preferences->palette_count)
+		selected = 0;
+
+	if(table == LCD_LUT_BG)
+		shades = gb->display.bg_palette;
+	else
+		shades = &gb->display.sp_palette[table << 2];
+
+	for(uint8_t c = 0; c < 4; c++)
+	{
+		uint32_t colour = preferences->palettes[selected].data[table][shades[c]];
+		gb->display.palette_lut[table][c] = colour | (colour << 16);
+	}
+}
+
+void gb_update_palette_lut(struct gb_s *gb)
+{
+	__gb_update_palette_lut(gb, LCD_LUT_OBJ0);
+	__gb_update_palette_lut(gb, LCD_LUT_OBJ1);
+	__gb_update_palette_lut(gb, LCD_LUT_BG);
+	gb->display.frame_dirty = 1;
+}
+
+/* Marks every tile map entry of the background plane cache as stale. */
+void __gb_bg_cache_invalidate(struct gb_s *gb)
+{
+	for(uint8_t map = 0; map < 2; map++)
+	{
+		for(uint16_t entry = 0; entry < 32 * 32; entry++)
+			gb->bg_cache->entries[map][entry].dirty = 1;
+	}
+}
+
+/* Tracks a write to VRAM, given as an offset into gb->vram, so that the
+ * affected parts of the background plane cache get decoded again. */
+static inline void __gb_bg_cache_write(struct gb_s *gb, uint_fast16_t vram_addr)
+{
+	uint_fast16_t bank_addr = vram_addr & (VRAM_BANK_SIZE - 1);
+
+	if(bank_addr >= VRAM_BMAP_1)
+	{
+		/* Tile map, or CGB attribute map in bank 1. */
+		gb->bg_cache->entries[(bank_addr >> 10) & 1][bank_addr & 0x3FF].dirty = 1;
+		return;
+	}
+
+	/* Tile data: 384 tiles per bank. */
+	gb->bg_cache->tile_version[(vram_addr >= VRAM_BANK_SIZE ? 384 : 0) + (bank_addr >> 4)]++;
+}
+
+/* Tracks a block write to VRAM. Both vram_addr and len are multiples of 16,
+ * so every tile is only touched once. */
+static inline void __gb_bg_cache_write_block(struct gb_s *gb,
+		uint_fast16_t vram_addr, uint_fast16_t len)
+{
+	for(; len; vram_addr += 0x10, len -= 0x10)
+	{
+		uint_fast16_t bank_addr = vram_addr & (VRAM_BANK_SIZE - 1);
+
+		if(bank_addr < VRAM_BMAP_1)
+		{
+			gb->bg_cache->tile_version[(vram_addr >= VRAM_BANK_SIZE ? 384 : 0) + (bank_addr >> 4)]++;
+			continue;
+		}
+
+		for(uint8_t i = 0; i < 0x10; i++)
+			gb->bg_cache->entries[(bank_addr >> 10) & 1][(bank_addr & 0x3FF) + i].dirty = 1;
+	}
+}
+
+/* Decodes one tile map entry into the background plane cache, using the
+ * current LCDC tile data selection. */
+void __gb_bg_cache_decode(struct gb_s *gb, uint8_t map, uint16_t entry)
+{
+	const uint16_t map_addr = (map ? VRAM_BMAP_2 : VRAM_BMAP_1) + entry;
+	const uint8_t idx = gb->vram[map_addr];
+	const uint8_t tile_select = (gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT) ? 1 : 0;
+	uint8_t attr = 0;
+	uint16_t tile;
+	uint16_t tile_addr;
+
+	/* Tile data index within a bank, 0x8000 based. */
+	if(tile_select)
+		tile = idx;
+	else
+		tile = ((VRAM_TILES_2 - VRAM_TILES_1) >> 4) + ((idx + 0x80) % 0x100);
+
+	tile_addr = tile * 0x10;
+
+#if PEANUT_FULL_GBC_SUPPORT
+	if(gb->cgb.cgbMode)
+		attr = gb->vram[map_addr + VRAM_BANK_SIZE];
+
+	if(attr & 0x08)
+	{
+		/* VRAM bank 2 */
+		tile += 384;
+		tile_addr += VRAM_BANK_SIZE;
+	}
+#endif
+
+	const uint8_t upper = (attr & 0x80) | ((attr & 0x07) << 2);
+	uint8_t *dst = &gb->bg_cache->plane[map][((entry >> 5) << 11) + ((entry & 0x1F) << 3)];
+
+	for(uint8_t py = 0; py < 8; py++, dst += 256)
+	{
+		/* Vertical flip */
+		const uint8_t row = (attr & 0x40) ? 7 - py : py;
+		uint8_t t1 = gb->vram[tile_addr + 2 * row];
+		uint8_t t2 = gb->vram[tile_addr + 2 * row + 1];
+
+		if(attr & 0x20)
+		{
+			/* Horizontal flip: leftmost pixel is bit 0 */
+			for(uint8_t px = 0; px < 8; px++, t1 >>= 1, t2 >>= 1)
+				dst[px] = upper | (t1 & 0x1) | ((t2 & 0x1) << 1);
+		}
+		else
+		{
+			for(uint8_t px = 0; px < 8; px++, t1 <<= 1, t2 <<= 1)
+				dst[px] = upper | ((t1 & 0x80) >> 7) | ((t2 & 0x80) >> 6);
+		}
+	}
+
+	gb->bg_cache->entries[map][entry].tile = tile;
+	gb->bg_cache->entries[map][entry].version = gb->bg_cache->tile_version[tile];
+	gb->bg_cache->entries[map][entry].tile_select = tile_select;
+	gb->bg_cache->entries[map][entry].dirty = 0;
+}
+
+/* Makes sure `count` consecutive entries of a tile map row, starting at
+ * column `col` and wrapping around, are decoded and up to date. */
+static inline void __gb_bg_cache_prepare(struct gb_s *gb, uint8_t map,
+		uint8_t tile_row, uint8_t col, uint8_t count)
+{
+	const uint8_t tile_select = (gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT) ? 1 : 0;
+
+	for(; count != 0; count--, col++)
+	{
+		const uint16_t entry = (tile_row << 5) | (col & 0x1F);
+		const struct gb_bg_cache *cache = gb->bg_cache;
+
+		if(cache->entries[map][entry].dirty
+				|| cache->entries[map][entry].tile_select != tile_select
+				|| cache->entries[map][entry].version != cache->tile_version[cache->entries[map][entry].tile])
+			__gb_bg_cache_decode(gb, map, entry);
+	}
+}
+
+#if PEANUT_FULL_GBC_SUPPORT
+/* Converts a CGB colour (xBBBBBGGGGGRRRRR) to a RGB565 colour which is
+ * doubled into both halves of the returned word, so it can be pushed to the
+ * panel as two horizontal pixels. */
+static inline uint32_t __gb_cgb_to_rgb565x2(uint16_t colour)
+{
+	uint32_t r = colour & 0x1F;
+	uint32_t g = (colour >> 5) & 0x1F;
+	uint32_t b = (colour >> 10) & 0x1F;
+	uint32_t rgb565 = (r << 11) | (g << 6) | ((g >> 4) << 5) | b;
+
+	return rgb565 | (rgb565 << 16);
+}
+#endif
+
 void __attribute__((section(".oc_mem.il.text"))) __set_rom_bank(struct gb_s *gb)
 {
-	uint8_t mask = 0xFF;
+	uint16_t mask = 0x1FF;
 
 	if(gb->mbc == 1 && gb->cart_mode_select)
 	{
 		mask = 0x1F;
 	}
 
-	gb->memory_map[0x4] = gb->rom + ((gb->selected_rom_bank & mask) * ROM_BANK_SIZE);
+	if(gb->gb_rom_bank)
+		gb->memory_map[0x4] = gb->gb_rom_bank(gb, gb->selected_rom_bank & mask);
+	else
+		gb->memory_map[0x4] = gb->rom + ((gb->selected_rom_bank & mask) * ROM_BANK_SIZE);
+
 	gb->memory_map[0x5] = gb->memory_map[0x4] + 0x1000;
 	gb->memory_map[0x6] = gb->memory_map[0x4] + 0x2000;
 	gb->memory_map[0x7] = gb->memory_map[0x4] + 0x3000;
@@ -485,6 +673,10 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_dma(struct gb_s *gb, uint1
   DMAC_CHCR_1->raw = 0;
 
   void *src_addr = gb->memory_map[PEANUT_GB_GET_MSN16(addr)] + (addr & 0xF00);
+
+  /* Most games copy an unchanged shadow OAM every frame */
+  if(!gb->display.frame_dirty && memcmp(gb->oam, src_addr, OAM_SIZE) != 0)
+    gb->display.frame_dirty = 1;
   
   *DMAC_SAR_1 = (uint32_t)virt_to_phys_addr(src_addr);
   *DMAC_DAR_1 = (uint32_t)gb->oam; // Will be in P4 Area => Physical address is same as virtual
@@ -493,6 +685,63 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_dma(struct gb_s *gb, uint1
   DMAC_CHCR_1->raw = tmp_chcr.raw;
 }
 
+/* Updates the lower nibble of JOYP from the selected button group. */
+static inline void __gb_update_joyp(struct gb_s *gb)
+{
+	/* Direction keys selected */
+	if((gb->hram_io[IO_JOYP] & 0x10) == 0)
+		gb->hram_io[IO_JOYP] |= (gb->direct.joypad >> 4);
+	/* Button keys selected */
+	else
+		gb->hram_io[IO_JOYP] |= (gb->direct.joypad & 0x0F);
+}
+
+/* Reports a JOYP read to the front-end if it returns the current state of
+ * the watched joypad bits. Only the selected button group is visible. */
+void __gb_joypad_watch(struct gb_s *gb)
+{
+	const uint8_t joyp = gb->hram_io[IO_JOYP];
+	uint8_t watch;
+	uint8_t state;
+
+	if((joyp & 0x10) == 0)
+	{
+		watch = gb->direct.joypad_watch >> 4;
+		state = gb->direct.joypad >> 4;
+	}
+	else if((joyp & 0x20) == 0)
+	{
+		watch = gb->direct.joypad_watch & 0x0F;
+		state = gb->direct.joypad & 0x0F;
+	}
+	else
+		return;
+
+	if(watch == 0 || ((joyp ^ state) & watch))
+		return;
+
+	gb->direct.joypad_watch = 0;
+
+	if(gb->gb_joypad_read)
+		gb->gb_joypad_read(gb);
+}
+
+uint8_t __gb_read_joyp(struct gb_s *gb)
+{
+	/* Let the front-end sample the keys at the time of the read. */
+	if(gb->gb_joypad_sample)
+	{
+		gb->gb_joypad_sample(gb);
+		gb->hram_io[IO_JOYP] &= 0xF0;
+		__gb_update_joyp(gb);
+	}
+
+	if(unlikely(gb->direct.joypad_watch))
+		__gb_joypad_watch(gb);
+
+	return gb->hram_io[IO_JOYP];
+}
+
 /**
  * Internal function used to read bytes.
  * addr is host platform endian.
@@ -536,6 +785,10 @@ uint8_t __attribute__((section(".oc_mem.il.text"))) __gb_read(struct gb_s *gb, u
 #endif
 		}
 
+		/* Joypad */
+		if(addr == 0xFF00)
+			return __gb_read_joyp(gb);
+
 		/* HRAM */
 #if PEANUT_FULL_GBC_SUPPORT
 		/* IO and Interrupts. */
@@ -584,6 +837,7 @@ uint8_t __attribute__((section(".oc_mem.il.text"))) __gb_read(struct gb_s *gb, u
 #if PEANUT_FULL_GBC_SUPPORT
 		}
 #endif
+		case 0x8:
 		case 0x9:
 #if PEANUT_FULL_GBC_SUPPORT
 		return gb->vram[addr - gb->cgb.vramBankOffset];
@@ -599,6 +853,85 @@ normal_read:
 	return gb->memory_map[PEANUT_GB_GET_MSN16(addr)][addr & 0xFFF];
 }
 
+#if PEANUT_FULL_GBC_SUPPORT
+/* Host pointer to a CGB DMA source address, or NULL if the page has to go
+ * through __gb_read(). */
+static inline const uint8_t *__gb_hdma_source(struct gb_s *gb, uint16_t addr)
+{
+	switch(PEANUT_GB_GET_MSN16(addr))
+	{
+	case 0x8:
+	case 0x9:
+	case 0xE:
+	case 0xF:
+		return NULL;
+
+	case 0xD:
+		if(gb->cgb.cgbMode)
+			return &gb->wram[addr - gb->cgb.wramBankOffset];
+
+	/* Intentional fall through. */
+	default:
+		return &gb->memory_map[PEANUT_GB_GET_MSN16(addr)][addr & 0xFFF];
+	}
+}
+
+/* Copies len bytes (a multiple of 16) of a general purpose or HBlank DMA
+ * into VRAM. Source and destination are resolved once per page instead of
+ * decoding every byte. The destination wraps around inside the VRAM bank. */
+void __gb_hdma_transfer(struct gb_s *gb, uint_fast16_t len)
+{
+	const uint_fast16_t bank = VRAM_ADDR - gb->cgb.vramBankOffset;
+	uint16_t src = gb->cgb.dmaSource & 0xFFF0;
+	uint_fast16_t dest = gb->cgb.dmaDest & 0x1FF0;
+
+	while(len)
+	{
+		const uint8_t *src_ptr = __gb_hdma_source(gb, src);
+		uint8_t *dest_ptr = &gb->vram[bank + dest];
+		uint_fast16_t chunk = len;
+
+		/* Split at source page and VRAM bank boundaries. */
+		if(chunk > (uint_fast16_t)(0x1000 - (src & 0xFFF)))
+			chunk = 0x1000 - (src & 0xFFF);
+
+		if(chunk > VRAM_BANK_SIZE - dest)
+			chunk = VRAM_BANK_SIZE - dest;
+
+		if(src_ptr)
+			memcpy(dest_ptr, src_ptr, chunk);
+		else
+		{
+			for(uint_fast16_t i = 0; i < chunk; i++)
+				dest_ptr[i] = __gb_read(gb, src + i);
+		}
+
+		__gb_bg_cache_write_block(gb, bank + dest, chunk);
+		gb->display.frame_dirty = 1;
+
+		src += chunk;
+		dest = (dest + chunk) & (VRAM_BANK_SIZE - 1);
+		len -= chunk;
+	}
+}
+#endif
+
+/* Marks the cart RAM page behind a changing write as dirty. Writes to
+ * the RTC registers are not tracked. */
+static inline void __gb_cram_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
+{
+	const uint8_t *dest = &gb->memory_map[PEANUT_GB_GET_MSN16(addr)][addr & 0xFFF];
+	const uint_fast32_t offset = dest - gb->cram;
+
+	if(dest < gb->cram || offset >= gb->cram_size || *dest == val)
+		return;
+
+	const uint_fast16_t page = offset >> CRAM_DIRTY_PAGE_SHIFT;
+
+	gb->cram_dirty[page >> 5] |= 1UL << (page & 31);
+	gb->cram_writes++;
+}
+
 /**
  * Internal function used to write bytes.
  */
@@ -613,6 +946,11 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 		{
 			gb->enable_cart_ram = ((val & 0x0F) == 0x0A);
 			__set_cram_bank(gb);
+
+			/* Games disable cart RAM once they finished saving. */
+			if(!gb->enable_cart_ram)
+				gb->cram_save_request = 1;
+
 			return;
 		}
 
@@ -694,11 +1032,28 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 
 	case 0x8:
 	case 0x9:
+	{
 #if PEANUT_FULL_GBC_SUPPORT
-		gb->vram[addr - gb->cgb.vramBankOffset] = val;
+		const uint_fast16_t vram_addr = addr - gb->cgb.vramBankOffset;
+#else
+		const uint_fast16_t vram_addr = addr - VRAM_ADDR;
 #endif
+		if(gb->vram[vram_addr] == val)
+			return;
+
+		gb->vram[vram_addr] = val;
+		__gb_bg_cache_write(gb, vram_addr);
+		gb->display.frame_dirty = 1;
+		return;
+	}
+
 	case 0xA:
 	case 0xB:
+		if(gb->enable_cart_ram)
+			__gb_cram_write(gb, addr, val);
+
+		goto normal_write;
+
 	case 0xC:
 	case 0xD:
 #if PEANUT_FULL_GBC_SUPPORT
@@ -719,6 +1074,9 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 
 		if(addr < UNUSED_ADDR)
 		{
+			if(gb->oam[addr - OAM_ADDR] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->oam[addr - OAM_ADDR] = val;
 			return;
 		}
@@ -755,14 +1113,7 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 			 * The lower bits are overwritten later, and the two most
 			 * significant bits are unused. */
 			gb->hram_io[IO_JOYP] = val;
-
-			/* Direction keys selected */
-			if((gb->hram_io[IO_JOYP] & 0x10) == 0)
-				gb->hram_io[IO_JOYP] |= (gb->direct.joypad >> 4);
-			/* Button keys selected */
-			else
-				gb->hram_io[IO_JOYP] |= (gb->direct.joypad & 0x0F);
-
+			__gb_update_joyp(gb);
 			return;
 
 		/* Serial */
@@ -804,6 +1155,9 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 			/* Check if LCD is already enabled. */
 			lcd_enabled = (gb->hram_io[IO_LCDC] & LCDC_ENABLE);
 
+			if(gb->hram_io[IO_LCDC] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_LCDC] = val;
 
 			/* Check if LCD is going to be switched on. */
@@ -826,6 +1180,7 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 				gb->hram_io[IO_LY] = 0;
 				/* Reset LCD timer. */
 				gb->counter.lcd_count = 0;
+				gb->counter.lcd_off_count = 0;
 			}
 			return;
 		}
@@ -835,10 +1190,16 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 			return;
 
 		case 0x42:
+			if(gb->hram_io[IO_SCY] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_SCY] = val;
 			return;
 
 		case 0x43:
+			if(gb->hram_io[IO_SCX] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_SCX] = val;
 			return;
 
@@ -863,35 +1224,53 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 
 		/* DMG Palette Registers */
 		case 0x47:
+			if(gb->hram_io[IO_BGP] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_BGP] = val;
 			gb->display.bg_palette[0] = (gb->hram_io[IO_BGP] & 0x03);
 			gb->display.bg_palette[1] = (gb->hram_io[IO_BGP] >> 2) & 0x03;
 			gb->display.bg_palette[2] = (gb->hram_io[IO_BGP] >> 4) & 0x03;
 			gb->display.bg_palette[3] = (gb->hram_io[IO_BGP] >> 6) & 0x03;
+			__gb_update_palette_lut(gb, LCD_LUT_BG);
 			return;
 
 		case 0x48:
+			if(gb->hram_io[IO_OBP0] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_OBP0] = val;
 			gb->display.sp_palette[0] = (gb->hram_io[IO_OBP0] & 0x03);
 			gb->display.sp_palette[1] = (gb->hram_io[IO_OBP0] >> 2) & 0x03;
 			gb->display.sp_palette[2] = (gb->hram_io[IO_OBP0] >> 4) & 0x03;
 			gb->display.sp_palette[3] = (gb->hram_io[IO_OBP0] >> 6) & 0x03;
+			__gb_update_palette_lut(gb, LCD_LUT_OBJ0);
 			return;
 
 		case 0x49:
+			if(gb->hram_io[IO_OBP1] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_OBP1] = val;
 			gb->display.sp_palette[4] = (gb->hram_io[IO_OBP1] & 0x03);
 			gb->display.sp_palette[5] = (gb->hram_io[IO_OBP1] >> 2) & 0x03;
 			gb->display.sp_palette[6] = (gb->hram_io[IO_OBP1] >> 4) & 0x03;
 			gb->display.sp_palette[7] = (gb->hram_io[IO_OBP1] >> 6) & 0x03;
+			__gb_update_palette_lut(gb, LCD_LUT_OBJ1);
 			return;
 
 		/* Window Position Registers */
 		case 0x4A:
+			if(gb->hram_io[IO_WY] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_WY] = val;
 			return;
 
 		case 0x4B:
+			if(gb->hram_io[IO_WX] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->hram_io[IO_WX] = val;
 			return;
 #if PEANUT_FULL_GBC_SUPPORT
@@ -936,10 +1315,7 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 			{  // Only transfer if dma is not active (=1) otherwise treat it as a termination
 				if(gb->cgb.cgbMode && (!gb->cgb.dmaMode))
 				{
-					for (int i = 0; i < (gb->cgb.dmaSize << 4); i++)
-					{
-						__gb_write(gb, ((gb->cgb.dmaDest & 0x1FF0) | 0x8000) + i, __gb_read(gb, (gb->cgb.dmaSource & 0xFFF0) + i));
-					}
+					__gb_hdma_transfer(gb, gb->cgb.dmaSize << 4);
 					gb->cgb.dmaSource += (gb->cgb.dmaSize << 4);
 					gb->cgb.dmaDest += (gb->cgb.dmaSize << 4);
 					gb->cgb.dmaSize = 0;
@@ -961,9 +1337,12 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 
 		/* CGB BG Palette*/
 		case 0x69:
+			if(gb->cgb.BGPalette[(gb->cgb.BGPaletteID & 0x3F)] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->cgb.BGPalette[(gb->cgb.BGPaletteID & 0x3F)] = val;
 			fixPaletteTemp = (gb->cgb.BGPalette[(gb->cgb.BGPaletteID & 0x3E) + 1] << 8) + (gb->cgb.BGPalette[(gb->cgb.BGPaletteID & 0x3E)]);
-			gb->cgb.fixPalette[((gb->cgb.BGPaletteID & 0x3E) >> 1)] = ((fixPaletteTemp & 0x7C00) >> 10) | (fixPaletteTemp & 0x03E0) | ((fixPaletteTemp & 0x001F) << 10);  // swap Red and Blue
+			gb->cgb.fixPalette[((gb->cgb.BGPaletteID & 0x3E) >> 1)] = __gb_cgb_to_rgb565x2(fixPaletteTemp);
 			if(gb->cgb.BGPaletteInc) gb->cgb.BGPaletteID = (++gb->cgb.BGPaletteID) & 0x3F;
 			return;
 
@@ -975,9 +1354,12 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_write(struct gb_s *gb, uin
 
 		/* CGB OAM Palette*/
 		case 0x6B:
+			if(gb->cgb.OAMPalette[(gb->cgb.OAMPaletteID & 0x3F)] != val)
+				gb->display.frame_dirty = 1;
+
 			gb->cgb.OAMPalette[(gb->cgb.OAMPaletteID & 0x3F)] = val;
 			fixPaletteTemp = (gb->cgb.OAMPalette[(gb->cgb.OAMPaletteID & 0x3E) + 1] << 8) + (gb->cgb.OAMPalette[(gb->cgb.OAMPaletteID & 0x3E)]);
-			gb->cgb.fixPalette[0x20 + ((gb->cgb.OAMPaletteID & 0x3E) >> 1)] = ((fixPaletteTemp & 0x7C00) >> 10) | (fixPaletteTemp & 0x03E0) | ((fixPaletteTemp & 0x001F) << 10);  // swap Red and Blue
+			gb->cgb.fixPalette[0x20 + ((gb->cgb.OAMPaletteID & 0x3E) >> 1)] = __gb_cgb_to_rgb565x2(fixPaletteTemp);
 			if(gb->cgb.OAMPaletteInc) gb->cgb.OAMPaletteID = (++gb->cgb.OAMPaletteID) & 0x3F;
 			return;
 
@@ -1217,330 +1599,196 @@ static int compare_sprites(const void *in1, const void *in2)
 }
 #endif
 
-void __attribute__((section(".oc_mem.il.text"))) __gb_draw_line(struct gb_s *gb)
+/**
+ * Per-line bitmasks with one bit per pixel. Screen column x is stored at bit
+ * x + LINE_MASK_OFFSET, which leaves room for sprites that are partially off
+ * the left or right edge of the screen.
+ */
+#define LINE_MASK_OFFSET	8
+#define LINE_MASK_WORDS		6
+
+/* Returns the 8 mask bits starting at bit `pos`. */
+static inline uint8_t __gb_line_mask_get(const uint32_t *mask, uint8_t pos)
 {
-	emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
-	palette selected_palette = preferences->palettes[preferences->config.selected_palette];
+	const uint8_t word = pos >> 5;
+	const uint8_t bit = pos & 0x1F;
+	uint32_t bits = mask[word] >> bit;
 
-	/* Select which buffer to use for the current line */
-	uint32_t *pixels = lcd_pixels[gb->hram_io[IO_LY] % 2];
+	if(bit > 24)
+		bits |= mask[word + 1] << (32 - bit);
 
-	/* If LCD not initialised by front-end, don't render anything. */
-	if(gb->display.lcd_draw_line == NULL)
-		return;
+	return bits & 0xFF;
+}
 
-  gb->direct.frame_drawn = !(gb->direct.frame_skip && (gb->display.frame_count % gb->direct.frame_skip_amount) != 0);
+/* Sets the mask bits given by `bits`, starting at bit `pos`. */
+static inline void __gb_line_mask_set(uint32_t *mask, uint8_t pos, uint8_t bits)
+{
+	const uint8_t word = pos >> 5;
+	const uint8_t bit = pos & 0x1F;
 
-	if(!gb->direct.frame_drawn)
-		return;
+	mask[word] |= (uint32_t)bits << bit;
 
-#if PEANUT_FULL_GBC_SUPPORT
-	uint8_t pixelsPrio[160] = {0};  //do these pixels have priority over OAM?
-#endif
+	if(bit > 24)
+		mask[word + 1] |= (uint32_t)bits >> (32 - bit);
+}
 
-	/* If interlaced mode is activated, check if we need to draw the current
-	 * line. */
-	if(gb->direct.interlace)
+/* Draws screen columns disp_x up to end of a BG or window line from a row of
+ * the background plane cache, starting at column src_x of the plane (which
+ * wraps around at 256). Also fills in the masks used by the sprite pass. */
+static inline void __gb_draw_bg_span(struct gb_s *gb, uint32_t *pixels,
+		const uint8_t *row, uint8_t src_x, uint8_t disp_x, uint8_t end,
+		uint32_t *bg_zero, uint32_t *bg_prio)
+{
+#if PEANUT_FULL_GBC_SUPPORT
+	if(gb->cgb.cgbMode)
 	{
-		if((gb->display.interlace_count == 0
-				&& (gb->hram_io[IO_LY] & 1) == 0)
-				|| (gb->display.interlace_count == 1
-						&& (gb->hram_io[IO_LY] & 1) == 1))
+		for(; disp_x < end; disp_x++, src_x++)
 		{
-			/* Compensate for missing window draw if required. */
-			if(gb->hram_io[IO_LCDC] & LCDC_WINDOW_ENABLE
-					&& gb->hram_io[IO_LY] >= gb->display.WY
-					&& gb->hram_io[IO_WX] <= 166)
-				gb->display.window_clear++;
+			const uint8_t p = row[src_x];
+			const uint8_t pos = disp_x + LINE_MASK_OFFSET;
+			const uint32_t bit = (uint32_t)1 << (pos & 0x1F);
 
-			return;
-		}
-	}
+			pixels[disp_x] = gb->cgb.fixPalette[p & 0x1F];
 
-	/* If background is enabled, draw it. */
-#if PEANUT_FULL_GBC_SUPPORT
-	if(gb->cgb.cgbMode || gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE)
-#else
-	if(gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE)
-#endif
-	{
-		uint8_t bg_y, disp_x, bg_x, idx, py, px, t1, t2;
-		uint16_t bg_map, tile;
+			if(p & 0x03)
+				bg_zero[pos >> 5] &= ~bit;
 
-		/* Calculate current background line to draw. Constant because
-		 * this function draws only this one line each time it is
-		 * called. */
-		bg_y = gb->hram_io[IO_LY] + gb->hram_io[IO_SCY];
+			if(p & 0x80)
+				bg_prio[pos >> 5] |= bit;
+		}
 
-		/* Get selected background map address for first tile
-		 * corresponding to current line.
-		 * 0x20 (32) is the width of a background tile, and the bit
-		 * shift is to calculate the address. */
-		bg_map =
-			((gb->hram_io[IO_LCDC] & LCDC_BG_MAP) ?
-			 VRAM_BMAP_2 : VRAM_BMAP_1)
-			+ (bg_y >> 3) * 0x20;
+		return;
+	}
+#endif
 
-		/* The displays (what the player sees) X coordinate, drawn right
-		 * to left. */
-		disp_x = LCD_WIDTH - 1;
+	for(; disp_x < end; disp_x++, src_x++)
+	{
+		const uint8_t p = row[src_x];
+		const uint8_t pos = disp_x + LINE_MASK_OFFSET;
 
-		/* The X coordinate to begin drawing the background at. */
-		bg_x = disp_x + gb->hram_io[IO_SCX];
+		pixels[disp_x] = gb->display.palette_lut[LCD_LUT_BG][p & 0x3];
 
-		/* Get tile index for current background tile. */
-		idx = gb->vram[bg_map + (bg_x >> 3)];
-#if PEANUT_FULL_GBC_SUPPORT
-		uint8_t idxAtt = gb->vram[bg_map + (bg_x >> 3) + 0x2000];
-#endif
-		/* Y coordinate of tile pixel to draw. */
-		py = (bg_y & 0x07);
-		/* X coordinate of tile pixel to draw. */
-		px = 7 - (bg_x & 0x07);
-
-		/* Select addressing mode. */
-		if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
-			tile = VRAM_TILES_1 + idx * 0x10;
-		else
-			tile = VRAM_TILES_2 + ((idx + 0x80) % 0x100) * 0x10;
-#if PEANUT_FULL_GBC_SUPPORT
-		if(gb->cgb.cgbMode)
-		{
-			if(idxAtt & 0x08) tile += 0x2000; //VRAM bank 2
-			if(idxAtt & 0x40) tile += 2 * (7 - py);
-		}
-		if(!(idxAtt & 0x40))
-		{
-			tile += 2 * py;
-		}
+		if(p & 0x03)
+			bg_zero[pos >> 5] &= ~((uint32_t)1 << (pos & 0x1F));
+	}
+}
 
-		/* fetch first tile */
-		if(gb->cgb.cgbMode && (idxAtt & 0x20))
-		{  //Horizantal Flip
-			t1 = gb->vram[tile] << px;
-			t2 = gb->vram[tile + 1] << px;
-		}
-		else
-		{
-			t1 = gb->vram[tile] >> px;
-			t2 = gb->vram[tile + 1] >> px;
-		}
-#else
-		tile += 2 * py;
+void __attribute__((section(".oc_mem.il.text"))) __gb_draw_line(struct gb_s *gb)
+{
+	/* Select which buffer to use for the current line */
+	uint32_t *pixels = lcd_pixels[gb->hram_io[IO_LY] % 2];
 
-		/* fetch first tile */
-		t1 = gb->vram[tile] >> px;
-		t2 = gb->vram[tile + 1] >> px;
-#endif
+	/* If LCD not initialised by front-end, don't render anything. */
+	if(gb->display.lcd_draw_line == NULL)
+		return;
 
-		for(; disp_x != 0xFF; disp_x--)
-		{
-			uint8_t c;
+  gb->direct.frame_drawn = !(gb->direct.frame_skip && (gb->display.frame_count % gb->direct.frame_skip_amount) != 0);
 
-			if(px == 8)
-			{
-				/* fetch next tile */
-				px = 0;
-				bg_x = disp_x + gb->hram_io[IO_SCX];
-				idx = gb->vram[bg_map + (bg_x >> 3)];
-#if PEANUT_FULL_GBC_SUPPORT
-				idxAtt = gb->vram[bg_map + (bg_x >> 3) + 0x2000];
-#endif
+	if(!gb->direct.frame_drawn)
+		return;
 
-				if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
-					tile = VRAM_TILES_1 + idx * 0x10;
-				else
-					tile = VRAM_TILES_2 + ((idx + 0x80) % 0x100) * 0x10;
+	/* Pixels where the BG/window has colour 0 (or is not drawn at all),
+	 * pixels with the CGB BG-to-OAM priority attribute, and pixels already
+	 * taken by a higher priority sprite. Off-screen columns start out as
+	 * taken so sprites are clipped for free. */
+	uint32_t bg_zero[LINE_MASK_WORDS] = {
+		0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+		0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF
+	};
 #if PEANUT_FULL_GBC_SUPPORT
-				if(gb->cgb.cgbMode)
-				{
-					if(idxAtt & 0x08) tile += 0x2000; //VRAM bank 2
-					if(idxAtt & 0x40) tile += 2 * (7 - py);
-				}
-				if(!(idxAtt & 0x40))
-				{
-					tile += 2 * py;
-				}
-#else
-				tile += 2 * py;
+	uint32_t bg_prio[LINE_MASK_WORDS] = {0};
 #endif
-				t1 = gb->vram[tile];
-				t2 = gb->vram[tile + 1];
-			}
-
-			/* copy background */
-#if PEANUT_FULL_GBC_SUPPORT
-			if(gb->cgb.cgbMode && (idxAtt & 0x20))
-			{  //Horizantal Flip
-				c = (((t1 & 0x80) >> 1) | (t2 & 0x80)) >> 6;
-				pixels[disp_x] = ((idxAtt & 0x07) << 2) + c;
-				pixelsPrio[disp_x] = (idxAtt >> 7);
-				t1 = t1 << 1;
-				t2 = t2 << 1;
-			}
-			else
-			{
-				c = (t1 & 0x1) | ((t2 & 0x1) << 1);
-				if(gb->cgb.cgbMode)
-				{
-					pixels[disp_x] = ((idxAtt & 0x07) << 2) + c;
-					pixelsPrio[disp_x] = (idxAtt >> 7);
-				}
-				else
-				{
-					pixels[disp_x] = gb->display.bg_palette[c];
-				}
-				t1 = t1 >> 1;
-				t2 = t2 >> 1;
-			}
-#else
-			c = (t1 & 0x1) | ((t2 & 0x1) << 1);
+	uint32_t obj_covered[LINE_MASK_WORDS] = {
+		0x000000FF, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0xFFFFFF00
+	};
 
-			pixels[disp_x] = selected_palette.data[LCD_PALETTE_BG >> 2][gb->display.bg_palette[c]];
-			pixels[disp_x] += (pixels[disp_x] << 16);
+	/* If interlaced mode is activated, check if we need to draw the current
+	 * line. Lines that still look like the last frame sent are left out as
+	 * well, until something changes the picture. */
+	if((gb->direct.interlace
+			&& ((gb->display.interlace_count == 0
+					&& (gb->hram_io[IO_LY] & 1) == 0)
+				|| (gb->display.interlace_count == 1
+					&& (gb->hram_io[IO_LY] & 1) == 1)))
+		|| (gb->display.frame_unchanged && !gb->display.frame_dirty))
+	{
+		/* Compensate for missing window draw if required. */
+		if(gb->hram_io[IO_LCDC] & LCDC_WINDOW_ENABLE
+				&& gb->hram_io[IO_LY] >= gb->display.WY
+				&& gb->hram_io[IO_WX] <= 166)
+			gb->display.window_clear++;
 
-			t1 = t1 >> 1;
-			t2 = t2 >> 1;
-#endif
-			px++;
-		}
+		return;
 	}
 
-	/* draw window */
-	if(gb->hram_io[IO_LCDC] & LCDC_WINDOW_ENABLE
+	const uint8_t window_visible = gb->hram_io[IO_LCDC] & LCDC_WINDOW_ENABLE
 			&& gb->hram_io[IO_LY] >= gb->display.WY
-			&& gb->hram_io[IO_WX] <= 166)
-	{
-		uint16_t win_line, tile;
-		uint8_t disp_x, win_x, py, px, idx, t1, t2, end;
-
-		/* Calculate Window Map Address. */
-		win_line = (gb->hram_io[IO_LCDC] & LCDC_WINDOW_MAP) ?
-						VRAM_BMAP_2 : VRAM_BMAP_1;
-		win_line += (gb->display.window_clear >> 3) * 0x20;
+			&& gb->hram_io[IO_WX] <= 166;
 
-		disp_x = LCD_WIDTH - 1;
-		win_x = disp_x - gb->hram_io[IO_WX] + 7;
+	/* First screen column covered by the window. The window always covers
+	 * the rest of the line, so the BG only has to be drawn up to here. */
+	uint8_t window_start = LCD_WIDTH;
 
-		// look up tile
-		py = gb->display.window_clear & 0x07;
-		px = 7 - (win_x & 0x07);
-		idx = gb->vram[win_line + (win_x >> 3)];
-#if PEANUT_FULL_GBC_SUPPORT
-		uint8_t idxAtt = gb->vram[win_line + (win_x >> 3) + 0x2000];
-#endif
+	if(window_visible)
+		window_start = gb->hram_io[IO_WX] < 7 ? 0 : gb->hram_io[IO_WX] - 7;
 
-		if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
-			tile = VRAM_TILES_1 + idx * 0x10;
-		else
-			tile = VRAM_TILES_2 + ((idx + 0x80) % 0x100) * 0x10;
 #if PEANUT_FULL_GBC_SUPPORT
-		if(gb->cgb.cgbMode)
-		{
-			if(idxAtt & 0x08) tile += 0x2000; //VRAM bank 2
-			if(idxAtt & 0x40) tile += 2 * (7 - py);
-		}
-		if(!(idxAtt & 0x40))
-		{
-			tile += 2 * py;
-		}
-
-		// fetch first tile
-		if(gb->cgb.cgbMode && (idxAtt & 0x20))
-		{  //Horizantal Flip
-			t1 = gb->vram[tile] << px;
-			t2 = gb->vram[tile + 1] << px;
-		}
-		else
-		{
-			t1 = gb->vram[tile] >> px;
-			t2 = gb->vram[tile + 1] >> px;
-		}
+	const uint8_t bg_enabled = gb->cgb.cgbMode || gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE;
 #else
+	const uint8_t bg_enabled = gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE;
+#endif
 
-		tile += 2 * py;
+	if(bg_enabled)
+		gb->display.bg_pixels_skipped += LCD_WIDTH - window_start;
 
-		// fetch first tile
-		t1 = gb->vram[tile] >> px;
-		t2 = gb->vram[tile + 1] >> px;
-#endif
+	/* If background is enabled, draw it. */
+	if(bg_enabled && window_start != 0)
+	{
+		uint8_t bg_x, bg_y, map;
+		const uint8_t *row;
 
-		// loop & copy window
-		end = (gb->hram_io[IO_WX] < 7 ? 0 : gb->hram_io[IO_WX] - 7) - 1;
+		/* Calculate current background line to draw. Constant because
+		 * this function draws only this one line each time it is
+		 * called. */
+		bg_y = gb->hram_io[IO_LY] + gb->hram_io[IO_SCY];
+		bg_x = gb->hram_io[IO_SCX];
+		map = (gb->hram_io[IO_LCDC] & LCDC_BG_MAP) ? 1 : 0;
 
-		for(; disp_x != end; disp_x--)
-		{
-			uint8_t c;
+		__gb_bg_cache_prepare(gb, map, bg_y >> 3, bg_x >> 3,
+				(((bg_x & 0x07) + window_start - 1) >> 3) + 1);
+		row = &gb->bg_cache->plane[map][bg_y << 8];
 
-			if(px == 8)
-			{
-				// fetch next tile
-				px = 0;
-				win_x = disp_x - gb->hram_io[IO_WX] + 7;
-				idx = gb->vram[win_line + (win_x >> 3)];
+		__gb_draw_bg_span(gb, pixels, row, bg_x, 0, window_start, bg_zero,
 #if PEANUT_FULL_GBC_SUPPORT
-				idxAtt = gb->vram[win_line + (win_x >> 3) + 0x2000];
+				bg_prio);
+#else
+				NULL);
 #endif
+	}
 
-				if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
-					tile = VRAM_TILES_1 + idx * 0x10;
-				else
-					tile = VRAM_TILES_2 + ((idx + 0x80) % 0x100) * 0x10;
+	/* draw window */
+	if(window_visible)
+	{
+		uint8_t disp_x, win_x, map;
+		const uint8_t *row;
 
-#if PEANUT_FULL_GBC_SUPPORT
-				if(gb->cgb.cgbMode)
-				{
-					if(idxAtt & 0x08) tile += 0x2000; //VRAM bank 2
-					if(idxAtt & 0x40) tile += 2 * (7 - py);
-				}
-				if(!(idxAtt & 0x40))
-				{
-					tile += 2 * py;
-				}
-#else
+		/* Window X coordinate of the first covered screen column. */
+		disp_x = window_start;
+		win_x = disp_x - gb->hram_io[IO_WX] + 7;
+		map = (gb->hram_io[IO_LCDC] & LCDC_WINDOW_MAP) ? 1 : 0;
 
-				tile += 2 * py;
-#endif
-				t1 = gb->vram[tile];
-				t2 = gb->vram[tile + 1];
-			}
+		__gb_bg_cache_prepare(gb, map, gb->display.window_clear >> 3, win_x >> 3,
+				((win_x + LCD_WIDTH - 1 - disp_x) >> 3) - (win_x >> 3) + 1);
+		row = &gb->bg_cache->plane[map][gb->display.window_clear << 8];
 
-			// copy window
+		// copy window
+		__gb_draw_bg_span(gb, pixels, row, win_x, disp_x, LCD_WIDTH, bg_zero,
 #if PEANUT_FULL_GBC_SUPPORT
-			if(idxAtt & 0x20)
-			{  //Horizantal Flip
-				c = (((t1 & 0x80) >> 1) | (t2 & 0x80)) >> 6;
-				pixels[disp_x] = ((idxAtt & 0x07) << 2) + c;
-				pixelsPrio[disp_x] = (idxAtt >> 7);
-				t1 = t1 << 1;
-				t2 = t2 << 1;
-			}
-			else
-			{
-				c = (t1 & 0x1) | ((t2 & 0x1) << 1);
-				if(gb->cgb.cgbMode)
-				{
-					pixels[disp_x] = ((idxAtt & 0x07) << 2) + c;
-					pixelsPrio[disp_x] = (idxAtt >> 7);
-				}
-				else
-				{
-					pixels[disp_x] = gb->display.bg_palette[c];
-				}
-				t1 = t1 >> 1;
-				t2 = t2 >> 1;
-			}
+				bg_prio);
 #else
-			c = (t1 & 0x1) | ((t2 & 0x1) << 1);
-
-			pixels[disp_x] = selected_palette.data[LCD_PALETTE_BG >> 2][gb->display.bg_palette[c]];
-			pixels[disp_x] += (pixels[disp_x] << 16);
-
-			t1 = t1 >> 1;
-			t2 = t2 >> 1;
+				NULL);
 #endif
-			px++;
-		}
 
 		gb->display.window_clear++; // advance window line
 	}
@@ -1593,22 +1841,44 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_draw_line(struct gb_s *gb)
 			number_of_sprites = MAX_SPRITES_LINE;
 #endif
 
-		/* Render each sprite, from low priority to high priority. */
+		/* Reverses the bit order of a byte, so tile rows become left to
+		 * right like the line masks. */
+#define R2(n)	n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n)	R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n)	R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+		static const uint8_t __attribute__((section(".oc_mem.y.text"))) bit_reverse[0x100] = {
+			R6(0), R6(2), R6(1), R6(3)
+		};
+#undef R6
+#undef R4
+#undef R2
+
+		/* When the CGB master priority (LCDC bit 0) is cleared, sprites
+		 * are always drawn over the BG and window. */
+#if PEANUT_FULL_GBC_SUPPORT
+		const uint8_t master_priority = !gb->cgb.cgbMode
+				|| (gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE);
+#endif
+
+		/* Render each sprite, from high priority to low priority. A
+		 * sprite's opaque pixels are taken even when the BG hides them,
+		 * so lower priority sprites never show through. */
 #if PEANUT_GB_HIGH_LCD_ACCURACY
 		/* Render the top ten prioritised sprites on this scanline. */
-		for(sprite_number = number_of_sprites - 1;
-				sprite_number != 0xFF;
-				sprite_number--)
+		for(sprite_number = 0;
+				sprite_number != number_of_sprites;
+				sprite_number++)
 		{
 			uint8_t s = sprites_to_render[sprite_number].sprite_number;
 #else
-		for (sprite_number = NUM_SPRITES - 1;
-			sprite_number != 0xFF;
-			sprite_number--)
+		for (sprite_number = 0;
+			sprite_number != NUM_SPRITES;
+			sprite_number++)
 		{
 			uint8_t s = sprite_number;
 #endif
-			uint8_t py, t1, t2, dir, start, end, shift, disp_x;
+			uint8_t py, t1, t2, opaque, hidden, draw, disp_x;
+			const uint32_t *colours;
 			/* Sprite Y position. */
 			uint8_t OY = gb->oam[4 * s + 0];
 			/* Sprite X position. */
@@ -1643,77 +1913,74 @@ void __attribute__((section(".oc_mem.il.text"))) __gb_draw_line(struct gb_s *gb)
 			{
 				t1 = gb->vram[((OF & OBJ_BANK) << 10) + VRAM_TILES_1 + OT * 0x10 + 2 * py];
 				t2 = gb->vram[((OF & OBJ_BANK) << 10) + VRAM_TILES_1 + OT * 0x10 + 2 * py + 1];
+				colours = &gb->cgb.fixPalette[0x20 + ((OF & OBJ_CGB_PALETTE) << 2)];
 			}
 			else
 #endif
 			{
 				t1 = gb->vram[VRAM_TILES_1 + OT * 0x10 + 2 * py];
 				t2 = gb->vram[VRAM_TILES_1 + OT * 0x10 + 2 * py + 1];
+				colours = gb->display.palette_lut[(OF & OBJ_PALETTE) ? LCD_LUT_OBJ1 : LCD_LUT_OBJ0];
 			}
 
-			// handle x flip
-			if(OF & OBJ_FLIP_X)
-			{
-				dir = 1;
-				start = (OX < 8 ? 0 : OX - 8);
-				end = MIN(OX, LCD_WIDTH);
-				shift = 8 - OX + start;
-			}
-			else
+			// handle x flip, bit 0 must be the leftmost pixel
+			if(!(OF & OBJ_FLIP_X))
 			{
-				dir = (uint8_t)-1;
-				start = MIN(OX, LCD_WIDTH) - 1;
-				end = (OX < 8 ? 0 : OX - 8) - 1;
-				shift = OX - (start + 1);
+				t1 = bit_reverse[t1];
+				t2 = bit_reverse[t2];
 			}
 
-			// copy tile
-			t1 >>= shift;
-			t2 >>= shift;
+			/* The sprite covers screen columns OX - 8 to OX - 1, which are
+			 * mask bits OX to OX + 7. */
+			opaque = t1 | t2;
 
-			/* TODO: Put for loop within the to if statements
-			 * because the BG priority bit will be the same for
-			 * all the pixels in the tile. */
-			for(disp_x = start; disp_x != end; disp_x += dir)
-			{
-				uint8_t c = (t1 & 0x1) | ((t2 & 0x1) << 1);
-				// check transparency / sprite overlap / background overlap
+			/* BG colours 1-3 hide the sprite if it is behind the BG, or
+			 * on CGB if the BG tile has priority. */
 #if PEANUT_FULL_GBC_SUPPORT
-				if(gb->cgb.cgbMode)
-				{
-					uint8_t isBackgroundDisabled = c && !(gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE);
-					uint8_t isPixelPriorityNonConflicting = c &&
-															!(pixelsPrio[disp_x] && (pixels[disp_x] & 0x3)) &&
-															!((OF & OBJ_PRIORITY) && (pixels[disp_x] & 0x3));
-
-					if(isBackgroundDisabled || isPixelPriorityNonConflicting)
-					{
-						/* Set pixel colour. */
-						pixels[disp_x] = ((OF & OBJ_CGB_PALETTE) << 2) + c + 0x20;  // add 0x20 to differentiate from BG
-					}
-				}
-				else
-#endif
-				if(c && !(OF & OBJ_PRIORITY && !((pixels[disp_x] & 0xFFFF) == selected_palette.data[LCD_PALETTE_BG >> 2][gb->display.bg_palette[0]])))
-				{
-					/* Set pixel colour. */
-					pixels[disp_x] = (OF & OBJ_PALETTE)
-						? selected_palette.data[(LCD_PALETTE_OBJ >> 2)][gb->display.sp_palette[c + 4]]
-						: selected_palette.data[(LCD_PALETTE_OBJ >> 2) - 1][gb->display.sp_palette[c]];
-					pixels[disp_x] += (pixels[disp_x] << 16);
-#if PEANUT_FULL_GBC_SUPPORT
-					/* Deselect BG palette. */
-					pixels[disp_x] &= ~LCD_PALETTE_BG;
+			if(!master_priority)
+				hidden = 0;
+			else if(OF & OBJ_PRIORITY)
+				hidden = ~__gb_line_mask_get(bg_zero, OX);
+			else
+				hidden = ~__gb_line_mask_get(bg_zero, OX) & __gb_line_mask_get(bg_prio, OX);
+#else
+			hidden = (OF & OBJ_PRIORITY) ? ~__gb_line_mask_get(bg_zero, OX) : 0;
 #endif
-				}
 
-				t1 = t1 >> 1;
-				t2 = t2 >> 1;
+			draw = opaque & ~hidden & ~__gb_line_mask_get(obj_covered, OX);
+			__gb_line_mask_set(obj_covered, OX, opaque);
+
+			// copy tile
+			for(disp_x = OX - 8; draw != 0; disp_x++, draw >>= 1, t1 >>= 1, t2 >>= 1)
+			{
+				if(draw & 0x1)
+					pixels[disp_x] = colours[(t1 & 0x1) | ((t2 & 0x1) << 1)];
 			}
 		}
 	}
 
 	gb->display.lcd_draw_line(gb, pixels, gb->hram_io[IO_LY]);
+	gb->display.frame_sent = 1;
+}
+
+/* Reports how the finished frame reached the front-end. If nothing changed
+ * the picture while a whole frame was sent, the next one will look the same
+ * until something is written. */
+static inline void __gb_present_frame(struct gb_s *gb)
+{
+	if(gb->lcd_blank || !(gb->hram_io[IO_LCDC] & LCDC_ENABLE))
+		gb->display.present = GB_PRESENT_BLANK;
+	else if(gb->display.frame_sent)
+		gb->display.present = GB_PRESENT_NEW;
+	else
+		gb->display.present = GB_PRESENT_UNCHANGED;
+
+	gb->display.frame_unchanged = gb->display.present != GB_PRESENT_BLANK
+		&& gb->direct.frame_drawn
+		&& !gb->direct.interlace
+		&& !gb->display.frame_dirty;
+	gb->display.frame_dirty = 0;
+	gb->display.frame_sent = 0;
 }
 #endif
 
@@ -3356,9 +3623,29 @@ void __gb_step_cpu(struct gb_s *gb)
 		}
 
 		/* If LCD is off, don't update LCD state or increase the LCD
-		 * ticks. */
+		 * ticks. Frames still end in time, so the front-end keeps
+		 * polling input and pacing while the game has the LCD off. */
 		if(!(gb->hram_io[IO_LCDC] & LCDC_ENABLE))
+		{
+#if PEANUT_FULL_GBC_SUPPORT
+			gb->counter.lcd_off_count += (inst_cycles >> gb->cgb.doubleSpeed);
+#else
+			gb->counter.lcd_off_count += inst_cycles;
+#endif
+
+			if(gb->counter.lcd_off_count >= LCD_LINE_CYCLES * LCD_VERT_LINES)
+			{
+				gb->counter.lcd_off_count -= LCD_LINE_CYCLES * LCD_VERT_LINES;
+				gb->gb_frame = 1;
+#if ENABLE_LCD
+				gb->display.frame_count++;
+				gb->direct.frame_drawn = 1;
+				__gb_present_frame(gb);
+#endif
+			}
+
 			continue;
+		}
 
 		/* LCD Timing */
 #if PEANUT_FULL_GBC_SUPPORT
@@ -3394,6 +3681,9 @@ void __gb_step_cpu(struct gb_s *gb)
 					(gb->hram_io[IO_STAT] & ~STAT_MODE) | IO_STAT_MODE_VBLANK;
 				gb->gb_frame = 1;
 				gb->hram_io[IO_IF] |= VBLANK_INTR;
+#if ENABLE_LCD
+				__gb_present_frame(gb);
+#endif
 				gb->lcd_blank = 0;
 
 				if(gb->hram_io[IO_STAT] & STAT_MODE_1_INTR)
@@ -3404,16 +3694,18 @@ void __gb_step_cpu(struct gb_s *gb)
 				 * the frame or skip it. */
 				gb->display.frame_count++;
 
+				gb->display.bg_pixels_skipped_last = gb->display.bg_pixels_skipped;
+				gb->display.bg_pixels_skipped = 0;
+
 				/* If interlaced is activated, change which lines get
 				 * updated. Also, only update lines on frames that are
-				 * actually drawn when frame skip is enabled. */
-				// if(gb->direct.interlace &&
-				// 	(!gb->direct.frame_skip ||
-				// 		gb->display.frame_skip_count))
-				// {
-				// 	gb->display.interlace_count =
-				// 		!gb->display.interlace_count;
-				// }
+				 * actually drawn when frame skip is enabled, so both
+				 * fields keep being shown. */
+				if(gb->direct.interlace && gb->direct.frame_drawn)
+				{
+					gb->display.interlace_count =
+						!gb->display.interlace_count;
+				}
 #endif
 			}
 			/* Normal Line */
@@ -3432,11 +3724,7 @@ void __gb_step_cpu(struct gb_s *gb)
 				//DMA GBC
 				if(gb->cgb.cgbMode && !gb->cgb.dmaActive && gb->cgb.dmaMode)
 				{
-					for (uint8_t i = 0; i < 0x10; i++)
-					{
-						__gb_write(gb, ((gb->cgb.dmaDest & 0x1FF0) | 0x8000) + i,
-								   __gb_read(gb, (gb->cgb.dmaSource & 0xFFF0) + i));
-					}
+					__gb_hdma_transfer(gb, 0x10);
 					gb->cgb.dmaSource += 0x10;
 					gb->cgb.dmaDest += 0x10;
 					if(!(--gb->cgb.dmaSize)) gb->cgb.dmaActive = 1;
@@ -3604,6 +3892,9 @@ void gb_reset(struct gb_s *gb)
 		}
 #endif
 		memset(gb->vram, 0x00, VRAM_SIZE);
+
+		if(gb->bg_cache != NULL)
+			__gb_bg_cache_invalidate(gb);
 	}
 	else
 	{
@@ -3620,6 +3911,7 @@ void gb_reset(struct gb_s *gb)
 	gb->counter.div_count = 0;
 	gb->counter.tima_count = 0;
 	gb->counter.serial_count = 0;
+	gb->counter.lcd_off_count = 0;
 
 	gb->direct.joypad = 0xFF;
 	gb->hram_io[IO_JOYP] = 0xCF;
@@ -3662,6 +3954,7 @@ void gb_reset(struct gb_s *gb)
 	{
 		gb->cgb.OAMPalette[(i << 1)] = gb->cgb.BGPalette[(i << 1)] = 0x7F;
 		gb->cgb.OAMPalette[(i << 1) + 1] = gb->cgb.BGPalette[(i << 1) + 1] = 0xFF;
+		gb->cgb.fixPalette[i] = gb->cgb.fixPalette[0x20 + i] = __gb_cgb_to_rgb565x2(0x7FFF);
 	}
 	gb->cgb.OAMPaletteID = 0;
 	gb->cgb.BGPaletteID = 0;
@@ -3734,6 +4027,10 @@ enum gb_init_error_e gb_init(struct gb_s *gb,
 	gb->gb_serial_rx = NULL;
 
 	gb->gb_bootrom_read = NULL;
+	gb->gb_joypad_read = NULL;
+	gb->gb_joypad_sample = NULL;
+	gb->gb_rom_bank = NULL;
+	gb->direct.joypad_watch = 0;
 
 	/* Check valid ROM using checksum value. */
 	{
@@ -3772,6 +4069,7 @@ enum gb_init_error_e gb_init(struct gb_s *gb,
 
 	gb->lcd_blank = 0;
 	gb->display.lcd_draw_line = NULL;
+	gb->bg_cache = NULL;
 	
 
 
@@ -3819,6 +4117,12 @@ void gb_init_lcd(struct gb_s *gb,
 	gb->direct.frame_skip = 0;
 	gb->direct.frame_drawn = 0;
 	gb->display.frame_count = 0;
+	gb->display.bg_pixels_skipped = 0;
+	gb->display.bg_pixels_skipped_last = 0;
+	gb->display.frame_dirty = 1;
+	gb->display.frame_unchanged = 0;
+	gb->display.frame_sent = 0;
+	gb->display.present = GB_PRESENT_BLANK;
 
 	gb->display.window_clear = 0;
 	gb->display.WY = 0;
@@ -3827,9 +4131,26 @@ void gb_init_lcd(struct gb_s *gb,
 }
 #endif
 
+void gb_redraw_frame(struct gb_s *gb)
+{
+	gb->display.frame_unchanged = 0;
+	gb->display.frame_dirty = 1;
+}
+
 void gb_set_cram(struct gb_s *gb, uint8_t *cram)
 {
   gb->cram = cram;
+  gb->cram_size = (cram)? gb_get_save_size(gb) : 0;
+  gb->cram_writes = 0;
+  gb->cram_save_request = 0;
+  memset(gb->cram_dirty, 0, sizeof(gb->cram_dirty));
+}
+
+void gb_set_bg_cache(struct gb_s *gb, struct gb_bg_cache *cache)
+{
+  gb->bg_cache = cache;
+  memset(cache->tile_version, 0, sizeof(cache->tile_version));
+  __gb_bg_cache_invalidate(gb);
 }
 
 void gb_set_bootrom(struct gb_s *gb,
@@ -3838,6 +4159,109 @@ void gb_set_bootrom(struct gb_s *gb,
 	gb->gb_bootrom_read = gb_bootrom_read;
 }
 
+void gb_set_rom_bank_read(struct gb_s *gb,
+		 uint8_t *(*gb_rom_bank)(struct gb_s*, const uint_fast16_t))
+{
+	gb->gb_rom_bank = gb_rom_bank;
+	__set_rom_bank(gb);
+}
+
+void gb_save_state(struct gb_s *gb, struct gb_s *state)
+{
+	memcpy(state, gb, sizeof(struct gb_s));
+
+	/* Pointers are only valid for the running context. */
+	state->gb_error = NULL;
+	state->gb_serial_tx = NULL;
+	state->gb_serial_rx = NULL;
+	state->gb_bootrom_read = NULL;
+	state->gb_joypad_read = NULL;
+	state->gb_joypad_sample = NULL;
+	state->gb_rom_bank = NULL;
+	state->wram = NULL;
+	state->vram = NULL;
+	state->oam = NULL;
+	state->hram_io = NULL;
+	state->rom = NULL;
+	state->cram = NULL;
+	memset(state->memory_map, 0, sizeof(state->memory_map));
+	state->bg_cache = NULL;
+	state->display.lcd_draw_line = NULL;
+	state->direct.priv = NULL;
+}
+
+void gb_restore_state(struct gb_s *gb, struct gb_s *state)
+{
+	/* Keep everything that belongs to the front-end rather than to the
+	 * emulated machine. */
+	state->gb_error = gb->gb_error;
+	state->gb_serial_tx = gb->gb_serial_tx;
+	state->gb_serial_rx = gb->gb_serial_rx;
+	state->gb_bootrom_read = gb->gb_bootrom_read;
+	state->gb_joypad_read = gb->gb_joypad_read;
+	state->gb_joypad_sample = gb->gb_joypad_sample;
+	state->gb_rom_bank = gb->gb_rom_bank;
+	state->wram = gb->wram;
+	state->vram = gb->vram;
+	state->oam = gb->oam;
+	state->hram_io = gb->hram_io;
+	state->rom = gb->rom;
+	state->cram = gb->cram;
+	state->cram_size = gb->cram_size;
+	state->bg_cache = gb->bg_cache;
+	state->display.lcd_draw_line = gb->display.lcd_draw_line;
+	memcpy(&state->direct, &gb->direct, sizeof(state->direct));
+
+	/* Pages still to be saved belong to the cart RAM file, not to the
+	 * state. */
+	memcpy(state->cram_dirty, gb->cram_dirty, sizeof(state->cram_dirty));
+	state->cram_writes = gb->cram_writes;
+	state->cram_save_request = gb->cram_save_request;
+
+	memcpy(gb, state, sizeof(struct gb_s));
+
+	/* Remap memory like gb_reset() does, but for the restored banks. */
+	gb->memory_map[0x0] = gb->rom;
+	gb->memory_map[0x1] = gb->memory_map[0x0] + 0x1000;
+	gb->memory_map[0x2] = gb->memory_map[0x0] + 0x2000;
+	gb->memory_map[0x3] = gb->memory_map[0x0] + 0x3000;
+
+	__set_rom_bank(gb);
+
+	gb->memory_map[0x8] = gb->vram;
+	gb->memory_map[0x9] = gb->memory_map[0x8] + 0x1000;
+
+	__set_cram_bank(gb);
+
+	gb->memory_map[0xC] = gb->wram;
+	gb->memory_map[0xD] = gb->memory_map[0xC] + 0x1000;
+
+	gb->memory_map[0xE] = gb->memory_map[0xC];
+	gb->memory_map[0xF] = gb->memory_map[0xD];
+
+	/* Derived state is rebuilt from the restored VRAM and palettes. */
+	if(gb->bg_cache)
+		gb_set_bg_cache(gb, gb->bg_cache);
+
+	gb_update_palette_lut(gb);
+	gb_redraw_frame(gb);
+}
+
+void gb_load_state(struct gb_s *gb, struct gb_s *state)
+{
+	gb_restore_state(gb, state);
+
+	/* The cart RAM changed behind the game's back, so all of it has to be
+	 * saved again. */
+	for(uint_fast32_t page = 0;
+			page < (gb->cram_size + CRAM_DIRTY_PAGE_SIZE - 1) >> CRAM_DIRTY_PAGE_SHIFT;
+			page++)
+		gb->cram_dirty[page >> 5] |= 1UL << (page & 31);
+
+	gb->cram_writes++;
+	gb->cram_save_request = (gb->cram_size != 0);
+}
+
 /**
  * This was taken from SameBoy, which is released under MIT Licence.
  */
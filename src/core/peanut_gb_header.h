@@ -146,6 +146,12 @@
 #define CRAM_BANK_SIZE  0x2000
 #define VRAM_BANK_SIZE  0x2000
 
+/* Cart RAM writes are tracked in pages of this size for saving. */
+#define CRAM_MAX_SIZE         0x20000
+#define CRAM_DIRTY_PAGE_SHIFT 8
+#define CRAM_DIRTY_PAGE_SIZE  (1 << CRAM_DIRTY_PAGE_SHIFT)
+#define CRAM_DIRTY_WORDS      (CRAM_MAX_SIZE / CRAM_DIRTY_PAGE_SIZE / 32)
+
 /* DIV Register is incremented at rate of 16384Hz.
  * 4194304 / 16384 = 256 clock cycles for one increment. */
 #define DIV_CYCLES          256
@@ -443,6 +449,7 @@ struct count_s
   uint_fast16_t div_count;	/* Divider Register Counter */
   uint_fast16_t tima_count;	/* Timer Counter */
   uint_fast16_t serial_count;	/* Serial Counter */
+  uint_fast32_t lcd_off_count;	/* Frame timing while the LCD is off */
 };
 
 #if ENABLE_LCD
@@ -500,6 +507,51 @@ enum gb_serial_rx_ret_e
   GB_SERIAL_RX_NO_CONNECTION = 1
 };
 
+/**
+ * How the last frame returned by gb_run_frame() reached the front-end.
+ */
+enum gb_present_e
+{
+  /* At least one line was passed to lcd_draw_line(). */
+  GB_PRESENT_NEW = 0,
+  /* Lines were left out as they look like the last frame sent. */
+  GB_PRESENT_UNCHANGED = 1,
+  /* LCD was off or still blank after being switched on. */
+  GB_PRESENT_BLANK = 2
+};
+
+/* Number of 16 byte tiles in tile data, over both VRAM banks in CGB. */
+#if PEANUT_FULL_GBC_SUPPORT
+#define BG_CACHE_TILE_COUNT	768
+#else
+#define BG_CACHE_TILE_COUNT	384
+#endif
+
+/**
+ * Decoded copy of both 32x32 tile maps as 256x256 pixel planes.
+ *
+ * Each plane byte holds the colour index in bits 1-0, the CGB palette number
+ * in bits 4-2 and the CGB BG-to-OAM priority in bit 7. Map entries are
+ * decoded lazily when a line needs them and they are stale: their map or
+ * attribute byte was written, LCDC tile select changed, or the tile data
+ * they were decoded from was written since.
+ */
+struct gb_bg_cache
+{
+  uint8_t plane[2][256 * 256];
+
+  struct
+  {
+    uint16_t tile;      /* Tile data index the entry was decoded from. */
+    uint16_t version;   /* tile_version[tile] at decode time. */
+    uint8_t dirty;
+    uint8_t tile_select;
+  } entries[2][32 * 32];
+
+  /* Incremented on every write to the corresponding tile data. */
+  uint16_t tile_version[BG_CACHE_TILE_COUNT];
+};
+
 /**
  * Emulator context.
  *
@@ -524,6 +576,18 @@ struct gb_s
   /* Read byte from boot ROM at given address. */
   uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t addr);
 
+  /* Called when a JOYP read first returns the joypad bits selected in
+   * direct.joypad_watch. May be NULL. */
+  void (*gb_joypad_read)(struct gb_s*);
+
+  /* Called on every JOYP read to refresh direct.joypad before the game
+   * sees it. May be NULL if the joypad is only updated between frames. */
+  void (*gb_joypad_sample)(struct gb_s*);
+
+  /* Returns the 16KB ROM bank to map at 0x4000. If NULL, the whole ROM
+   * has to be available at rom. */
+  uint8_t *(*gb_rom_bank)(struct gb_s*, const uint_fast16_t bank);
+
   struct
   {
     uint8_t gb_halt		: 1;
@@ -572,8 +636,21 @@ struct gb_s
   uint8_t *rom;
   uint8_t *cram;
 
+  /* Size of cram, set by gb_set_cram(). */
+  uint_fast32_t cram_size;
+
+  /* Cart RAM pages written with a new value since the front-end last
+   * saved them, one bit per page. */
+  uint32_t cram_dirty[CRAM_DIRTY_WORDS];
+  /* Counts cart RAM writes that changed a byte. */
+  uint32_t cram_writes;
+  /* Set when the game disables cart RAM. Cleared by the front-end. */
+  uint8_t cram_save_request;
+
   uint8_t *memory_map[0x10];
 
+  struct gb_bg_cache *bg_cache;
+
   struct
   {
     /**
@@ -608,6 +685,24 @@ struct gb_s
 
     uint32_t frame_count;
     uint8_t interlace_count : 1;
+
+    /* Set when anything changed that affects the picture. */
+    uint8_t frame_dirty : 1;
+    /* Set while the picture is known to match what was last sent. */
+    uint8_t frame_unchanged : 1;
+    /* Set once a line of the current frame was sent. */
+    uint8_t frame_sent : 1;
+    /* enum gb_present_e of the last finished frame. */
+    uint8_t present : 2;
+
+    /* BG pixels not rendered because the window covers them, counted for
+     * the frame in progress and latched for the last finished frame. */
+    uint16_t bg_pixels_skipped;
+    uint16_t bg_pixels_skipped_last;
+
+    /* DMG colours as doubled panel pixels, indexed like palette.data:
+     * OBJ0, OBJ1 then BG. Kept up to date by gb_update_palette_lut(). */
+    uint32_t palette_lut[3][4];
   } display;
 #if PEANUT_FULL_GBC_SUPPORT
 	/* Game Boy Color Mode*/
@@ -619,7 +714,7 @@ struct gb_s
 		uint16_t wramBankOffset;
 		uint8_t vramBank;
 		uint16_t vramBankOffset;
-		uint16_t fixPalette[0x40];  //BG then OAM palettes fixed for the screen
+		uint32_t fixPalette[0x40];  //BG then OAM palettes as doubled RGB565, ready for the screen
 		uint8_t OAMPalette[0x40];
 		uint8_t BGPalette[0x40];
 		uint8_t OAMPaletteID;
@@ -668,6 +763,10 @@ struct gb_s
       uint8_t joypad;
     };
 
+    /* Joypad bits to report to gb_joypad_read once the game read their
+     * current state from JOYP. Cleared when reported. */
+    uint8_t joypad_watch;
+
     /* Implementation defined data. Set to NULL if not required. */
     void *priv;
   } direct;
@@ -786,6 +885,23 @@ uint_fast32_t gb_get_save_size(struct gb_s *gb);
  */
 uint8_t gb_colour_hash(struct gb_s *gb);
 
+/**
+ * Recomputes the DMG colour lookup tables from BGP, OBP0, OBP1 and the
+ * currently selected colour palette. Must be called when the selected
+ * palette or its colours change.
+ *
+ * \param gb	An initialised emulator context. Must not be NULL.
+ */
+void gb_update_palette_lut(struct gb_s *gb);
+
+/**
+ * Makes the next frame send every line to lcd_draw_line(). Must be called
+ * when the front-end changed the screen behind the emulator's back.
+ *
+ * \param gb	An initialised emulator context. Must not be NULL.
+ */
+void gb_redraw_frame(struct gb_s *gb);
+
 /**
  * Returns the title of ROM.
  *
@@ -820,4 +936,58 @@ void gb_set_rtc(struct gb_s *gb, const struct tm * const time);
 void gb_set_bootrom(struct gb_s *gb,
   uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t));
 
+/**
+ * Sets the cart RAM, which must hold gb_get_save_size() bytes, and marks
+ * all of it as saved.
+ */
 void gb_set_cram(struct gb_s *gb, uint8_t *cram);
+
+/**
+ * Loads switchable ROM banks through a function instead of mapping them
+ * from the ROM passed to gb_init(), which then only needs to hold bank 0.
+ * Remaps the selected bank right away.
+ *
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param gb_rom_bank Function returning the given 16KB ROM bank.
+ */
+void gb_set_rom_bank_read(struct gb_s *gb,
+  uint8_t *(*gb_rom_bank)(struct gb_s*, const uint_fast16_t));
+
+/**
+ * Sets the background plane cache used to render BG and window lines and
+ * invalidates its content. Must be set before gb_run_frame() is called.
+ *
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param cache	Allocated cache. Must not be NULL.
+ */
+void gb_set_bg_cache(struct gb_s *gb, struct gb_bg_cache *cache);
+
+/**
+ * Copies the emulated machine's state for a save state. Callbacks and
+ * memory pointers are cleared, the contents of WRAM, VRAM, OAM, HRAM/IO
+ * and cart RAM have to be saved by the front-end.
+ *
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param state	Receives the state. Must not be NULL.
+ */
+void gb_save_state(struct gb_s *gb, struct gb_s *state);
+
+/**
+ * Restores a state copied by gb_save_state() into a context running the
+ * same ROM. Callbacks, memory pointers and the direct settings of gb are
+ * kept. The memory contents have to be restored by the front-end first.
+ * All of cart RAM is marked as dirty.
+ *
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param state	The state to restore. Is modified.
+ */
+void gb_load_state(struct gb_s *gb, struct gb_s *state);
+
+/**
+ * Same as gb_load_state(), but the pages of cart RAM that are marked as
+ * dirty stay as they are. The front-end marks the pages it changed.
+ *
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param state	The state to restore. Is modified.
+ */
+void gb_restore_state(struct gb_s *gb, struct gb_s *state);
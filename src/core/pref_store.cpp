@@ -0,0 +1,121 @@
+#include "pref_store.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "../helpers/arena.h"
+#include "../helpers/fileio.h"
+#include "../helpers/functions.h"
+#include "../helpers/macros.h"
+
+#define PREF_STORE_MAGIC 0x43504250 // "CPBP"
+
+// Stores are only read by the platform that wrote them, so the header and 
+// the records are kept in native byte order
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint16_t count;
+  uint16_t reserved;
+  // FNV-1a over the records
+  uint32_t checksum;
+} pref_store_header;
+
+static uint32_t store_checksum(const uint8_t *data, uint32_t len)
+{
+  uint32_t hash = 2166136261U;
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    hash = (hash ^ data[i]) * 16777619U;
+  }
+
+  return hash;
+}
+
+uint8_t pref_store_read(const char *name, void *records, uint16_t record_size, 
+  uint16_t max_count, uint16_t *count)
+{
+  uint8_t *data;
+  uint32_t size;
+  pref_store_header header;
+
+  if (read_mcs(MCS_DIRECTORY, name, (void **)&data, &size))
+  {
+    return 1;
+  }
+
+  // Mcs data does not have to be aligned for the header
+  if (!data || size < sizeof(header))
+  {
+    set_error_i(EPREFS, name);
+    return 1;
+  }
+
+  memcpy(&header, data, sizeof(header));
+
+  const uint32_t records_size = header.count * record_size;
+
+  if (
+    header.magic != PREF_STORE_MAGIC ||
+    header.version != PREF_STORE_VERSION ||
+    header.record_size != record_size ||
+    header.count > max_count ||
+    size < sizeof(header) + records_size ||
+    header.checksum != store_checksum(data + sizeof(header), records_size)
+  )
+  {
+    set_error_i(EPREFS, name);
+    return 1;
+  }
+
+  memcpy(records, data + sizeof(header), records_size);
+  *count = header.count;
+
+  return 0;
+}
+
+uint8_t pref_store_write(const char *name, const void *records, 
+  uint16_t record_size, uint16_t count)
+{
+  const uint32_t records_size = count * record_size;
+  const uint32_t size = align_val(sizeof(pref_store_header) + records_size, 4);
+
+  // Only needed until it was written
+  arena_mark mark = arena_get_mark(&session_arena);
+  uint8_t *data = (uint8_t *)arena_alloc(&session_arena, size);
+
+  if (!data)
+  {
+    char err_info[ERROR_MAX_INFO_LEN];
+    char tmp[12];
+
+    strlcpy(err_info, name, sizeof(err_info));
+    strlcat(err_info, ": ", sizeof(err_info));
+    strlcat(err_info, itoa(size, tmp, 10), sizeof(err_info));
+    strlcat(err_info, "B", sizeof(err_info));
+
+    set_error_i(EMALLOC, err_info);
+    return 1;
+  }
+
+  pref_store_header header;
+  header.magic = PREF_STORE_MAGIC;
+  header.version = PREF_STORE_VERSION;
+  header.record_size = record_size;
+  header.count = count;
+  header.reserved = 0;
+  header.checksum = store_checksum((const uint8_t *)records, records_size);
+
+  memset(data, 0, size);
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), records, records_size);
+
+  uint8_t ret = write_mcs(MCS_DIRECTORY, name, data, size);
+
+  arena_release(&session_arena, mark);
+
+  return ret;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary stores in MCS_DIRECTORY, one per category of preferences
+#define PREF_STORE_CONTROLS "CtrlBin"
+#define PREF_STORE_PALETTES "PalBin"
+#define PREF_STORE_CONFIGS  "CfgBin"
+
+// Has to change whenever one of the stored structs changes
+#define PREF_STORE_VERSION  1
+
+/**
+ * Reads the records of a store. The store is rejected if it was written by
+ * another version, for another record size or if its checksum is wrong.
+ * 
+ * @param name        The mcs variable of the store
+ * @param records     Where the records will be copied to
+ * @param record_size The size of one record
+ * @param max_count   The amount of records that fit into records
+ * @param count       A pointer to where the amount of records will be written
+ * 
+ * @return Returns 0 on success else an error occured, errno is EPREFS if the
+ *         store exists but was rejected
+*/
+uint8_t pref_store_read(const char *name, void *records, uint16_t record_size, 
+  uint16_t max_count, uint16_t *count);
+
+/**
+ * Writes all records of a store at once. 
+ * 
+ * @param name        The mcs variable of the store
+ * @param records     The records to be written
+ * @param record_size The size of one record
+ * @param count       The amount of records
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t pref_store_write(const char *name, const void *records, 
+  uint16_t record_size, uint16_t count);
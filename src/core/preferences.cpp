@@ -4,12 +4,14 @@
 #include <string.h>
 #include <sdk/os/file.hpp>
 #include <sdk/os/debug.hpp>
+#include "../helpers/arena.h"
 #include "../helpers/fileio.h"
 #include "../helpers/ini.h"
 #include "../helpers/functions.h"
 #include "../helpers/macros.h"
 #include "error.h"
 #include "emulator.h"
+#include "pref_store.h"
 
 #define CONFIG_VAR_CONSTANT             "C_"
 
@@ -17,11 +19,18 @@
 #define CONFIG_INI_INTERLACE_ENABLE_KEY "interl_en"
 #define CONFIG_INI_FRAMESKIP_ENABLE_KEY "fs_en"
 #define CONFIG_INI_FRAMESKIP_AMOUNT_KEY "fs_am"
+#define CONFIG_INI_FRAMESKIP_AUTO_KEY   "fs_auto"
+#define CONFIG_INI_FRAMESKIP_AUTO_AM_KEY "fs_auto_am"
 #define CONFIG_INI_EMU_SPEED_KEY        "emu_spd"
 #define CONFIG_INI_OVERCLOCK_ENABLE_KEY "oclk_en"
 #define CONFIG_INI_SELECTED_PALETTE_KEY "sel_pal"
+#define CONFIG_INI_SCALER_KEY           "scl"
+#define CONFIG_INI_LAZY_INPUT_KEY       "lz_in"
+#define CONFIG_INI_REWIND_ENABLE_KEY    "rw_en"
+#define CONFIG_INI_REWIND_INTERVAL_KEY  "rw_int"
+#define CONFIG_INI_REWIND_BUFFER_KEY    "rw_buf"
 
-char *get_rom_config_var_name(emu_preferences *preferences, char *name_buffer)
+uint32_t get_rom_config_hash(emu_preferences *preferences)
 {
   char *str = preferences->current_rom_name;
 
@@ -31,9 +40,14 @@ char *get_rom_config_var_name(emu_preferences *preferences, char *name_buffer)
     str = preferences->current_filename;
   } 
 
+  return hash_string(str, 0xFFFFFF);
+}
+
+char *get_rom_config_var_name(uint32_t rom_hash, char *name_buffer)
+{
 	strcpy(name_buffer, CONFIG_VAR_CONSTANT);
   itoa_leading_zeros(
-    hash_string(str, 0xFFFFFF), 
+    rom_hash, 
     name_buffer + (sizeof(CONFIG_VAR_CONSTANT) - 1),
     16,
     6
@@ -47,172 +61,220 @@ struct gb_s *set_config_defaults(struct gb_s *gb)
   emu_preferences *prefs = (emu_preferences *)(gb->direct.priv);
   
   set_interlacing(gb, DEFAULT_INTERLACE_ENABLE);
+  set_scaler(gb, DEFAULT_SCALER);
+  set_frameskip_auto(gb, DEFAULT_FRAMESKIP_AUTO);
+  prefs->config.frameskip_auto_amount = DEFAULT_FRAMESKIP_AUTO_AM;
   set_frameskip(gb, DEFAULT_FRAMESKIP_ENABLE, DEFAULT_FRAMESKIP_AMOUNT);
   set_emu_speed(gb, DEFAULT_EMU_SPEED);
   set_overclock(gb, DEFAULT_OVERCLOCK_ENABLE);
+  set_lazy_input(gb, DEFAULT_LAZY_INPUT);
+  set_rewind(gb, DEFAULT_REWIND_ENABLE, DEFAULT_REWIND_INTERVAL, DEFAULT_REWIND_BUFFER);
 
   prefs->config.selected_palette = DEFAULT_SELECTED_PALETTE;
 
   return gb;
 }
 
-uint8_t process_config_ini(char *ini_string, uint32_t len, struct gb_s *gb)
+static const ini_binding config_bindings[] = 
+{
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_INTERLACE_ENABLE_KEY, INI_FIELD_BOOL, rom_config, interlacing_enabled),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_FRAMESKIP_ENABLE_KEY, INI_FIELD_BOOL, rom_config, frameskip_enabled),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_FRAMESKIP_AMOUNT_KEY, INI_FIELD_U8, rom_config, frameskip_amount),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_FRAMESKIP_AUTO_KEY, INI_FIELD_BOOL, rom_config, frameskip_auto),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_FRAMESKIP_AUTO_AM_KEY, INI_FIELD_U8, rom_config, frameskip_auto_amount),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_EMU_SPEED_KEY, INI_FIELD_U16, rom_config, emulation_speed),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_OVERCLOCK_ENABLE_KEY, INI_FIELD_BOOL, rom_config, overclock_enabled),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_SELECTED_PALETTE_KEY, INI_FIELD_U8, rom_config, selected_palette),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_SCALER_KEY, INI_FIELD_U8, rom_config, scaler),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_LAZY_INPUT_KEY, INI_FIELD_BOOL, rom_config, lazy_input),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_REWIND_ENABLE_KEY, INI_FIELD_BOOL, rom_config, rewind_enabled),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_REWIND_INTERVAL_KEY, INI_FIELD_U8, rom_config, rewind_interval),
+  INI_BIND(CONFIG_INI_SECTION_NAME, CONFIG_INI_REWIND_BUFFER_KEY, INI_FIELD_U8, rom_config, rewind_buffer),
+};
+
+#define CONFIG_BINDING_COUNT (sizeof(config_bindings) / sizeof(config_bindings[0]))
+
+// Values go through the setters so they get validated and applied
+void apply_rom_config(struct gb_s *gb, rom_config *config)
 {
   emu_preferences *prefs = (emu_preferences *)(gb->direct.priv);
 
-  ini_file file;
-  ini_parse(ini_string, len, &file);
+  set_frameskip(gb, config->frameskip_enabled, config->frameskip_amount);
+
+  // Auto mode starts from the amount it settled on last session
+  prefs->config.frameskip_auto_amount = 
+    clamp(config->frameskip_auto_amount, (uint8_t)0, prefs->config.frameskip_amount);
+  set_frameskip_auto(gb, config->frameskip_auto);
+
+  set_interlacing(gb, config->interlacing_enabled);
+  set_scaler(gb, config->scaler);
+  set_emu_speed(gb, config->emulation_speed);
+  set_overclock(gb, config->overclock_enabled);
+  prefs->config.selected_palette = config->selected_palette;
+  set_lazy_input(gb, config->lazy_input);
+  set_rewind(gb, config->rewind_enabled, config->rewind_interval, config->rewind_buffer);
+}
+
+uint8_t process_config_ini(char *ini_string, uint32_t len, struct gb_s *gb)
+{
+  emu_preferences *prefs = (emu_preferences *)(gb->direct.priv);
 
-  ini_section *section = find_section(&file, CONFIG_INI_SECTION_NAME);
+  // Keys missing in the file keep the defaults that were set before
+  rom_config config = prefs->config;
 
-  if (!section)
+  if (!ini_read_bindings(ini_string, len, config_bindings, CONFIG_BINDING_COUNT, &config))
   {
-    free_ini_file(&file);
     return 1;
   }
 
-  ini_key *interl_en = find_key(section, CONFIG_INI_INTERLACE_ENABLE_KEY);
-  ini_key *fs_en = find_key(section, CONFIG_INI_FRAMESKIP_ENABLE_KEY);
-  ini_key *fs_amount = find_key(section, CONFIG_INI_FRAMESKIP_AMOUNT_KEY);
-  ini_key *emu_speed = find_key(section, CONFIG_INI_EMU_SPEED_KEY);
-  ini_key *oclk_en = find_key(section, CONFIG_INI_OVERCLOCK_ENABLE_KEY);
-  ini_key *sel_pal = find_key(section, CONFIG_INI_SELECTED_PALETTE_KEY);
+  apply_rom_config(gb, &config);
+  
+  return 0;
+}
 
-  if (fs_en && fs_amount)
-  {
-    set_frameskip(gb, fs_en->value_int, fs_amount->value_int);
-  }
+char *create_config_ini(rom_config *config, char *ini_string, uint32_t len)
+{
+  return ini_write_bindings(config_bindings, CONFIG_BINDING_COUNT, config, ini_string, len);
+}
 
-  if (interl_en)
+rom_config_record *find_rom_config(emu_preferences *preferences, uint32_t rom_hash)
+{
+  for (uint8_t i = 0; i < preferences->rom_config_count; i++)
   {
-    set_interlacing(gb, false); // Interlacing is currently not working and therefore defaults to disabled
-    // set_interlacing(gb, interl_en->value_int);
+    if (preferences->rom_configs[i].rom_hash == rom_hash)
+    {
+      return &(preferences->rom_configs[i]);
+    }
   }
 
-  if (emu_speed)
-  {
-    set_emu_speed(gb, emu_speed->value_int);
-  }
+  return nullptr;
+}
 
-  if (oclk_en)
-  {
-    set_overclock(gb, oclk_en->value_int);
-  }
+uint8_t import_rom_config_ini(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
 
-  if (sel_pal)
+  uint32_t size;
+  char *ini_string;
+  char var_name[MAX_FILENAME_LEN];
+
+  get_rom_config_var_name(get_rom_config_hash(preferences), var_name);
+
+  if (read_mcs(MCS_DIRECTORY, var_name, (void **)&ini_string, &size))
   {
-    prefs->config.selected_palette = sel_pal->value_int;
+    return 1;
   }
 
-  free_ini_file(&file);
-  
-  return 0;
+  return process_config_ini(ini_string, size, gb);
 }
 
-char *create_config_ini(rom_config *config, char *ini_string, uint32_t len)
+uint8_t export_rom_config_ini(rom_config_record *record)
 {
-  ini_file file;
-  file.section_count = 0;
-  file.sections_size = 0;
-  file.sections = nullptr;
+  char var_name[MAX_FILENAME_LEN];
+  char ini_string[INI_MAX_CONTENT_LEN];
 
-  ini_section *config_section = add_section(&file, CONFIG_INI_SECTION_NAME);
+  get_rom_config_var_name(record->rom_hash, var_name);
   
-  if (!config_section)
+  if (!create_config_ini(&(record->config), ini_string, INI_MAX_CONTENT_LEN)) 
   {
-    free_ini_file(&file);
-    return nullptr;
+    return 1;
   }
-  
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_INTERLACE_ENABLE_KEY,
-    INI_TYPE_INT,
-    config->interlacing_enabled
-  )) 
+
+  uint32_t size = align_val(strlen(ini_string), 4);
+
+  return write_mcs(MCS_DIRECTORY, var_name, ini_string, size);
+}
+
+static void add_rejected_store(char *list, uint32_t size, const char *name)
+{
+  if (list[0] != '\0')
   {
-    free_ini_file(&file);
-    return nullptr;
+    strlcat(list, ", ", size);
   }
-  
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_FRAMESKIP_ENABLE_KEY,
-    INI_TYPE_INT,
-    config->frameskip_enabled
-  )) 
+
+  strlcat(list, name, size);
+}
+
+uint8_t load_preferences(emu_preferences *preferences)
+{
+  const uint32_t palettes_size = MAX_PALETTE_COUNT * sizeof(palette);
+  const uint32_t configs_size = MAX_ROM_CONFIGS * sizeof(rom_config_record);
+
+  // Kept for the whole session
+  preferences->stored_palettes = (palette *)arena_alloc(&session_arena, palettes_size);
+  preferences->rom_configs = (rom_config_record *)arena_alloc(&session_arena, configs_size);
+
+  if (!preferences->stored_palettes || !preferences->rom_configs)
   {
-    free_ini_file(&file);
-    return nullptr;
+    char err_info[ERROR_MAX_INFO_LEN];
+    char tmp[12];
+
+    strlcpy(err_info, "Preferences: ", sizeof(err_info));
+    strlcat(err_info, itoa(palettes_size + configs_size, tmp, 10), sizeof(err_info));
+    strlcat(err_info, "B", sizeof(err_info));
+
+    set_error_i(EMALLOC, err_info);
+    return 1;
   }
-  
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_FRAMESKIP_AMOUNT_KEY,
-    INI_TYPE_INT,
-    config->frameskip_amount
-  )) 
+
+  // Whatever can not be read falls back to the defaults. Rejected stores are
+  // collected, so the user can be told before they get overwritten.
+  char rejected[ERROR_MAX_INFO_LEN] = "";
+
+  if (load_controls(&(preferences->controls)) && errno == EPREFS)
   {
-    free_ini_file(&file);
-    return nullptr;
+    add_rejected_store(rejected, sizeof(rejected), PREF_STORE_CONTROLS);
   }
 
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_EMU_SPEED_KEY,
-    INI_TYPE_INT,
-    config->emulation_speed
-  )) 
+  if (load_user_palettes(preferences->stored_palettes, 
+    &(preferences->stored_palette_count)) && errno == EPREFS)
   {
-    free_ini_file(&file);
-    return nullptr;
+    add_rejected_store(rejected, sizeof(rejected), PREF_STORE_PALETTES);
   }
 
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_OVERCLOCK_ENABLE_KEY,
-    INI_TYPE_INT,
-    config->overclock_enabled
-  )) 
+  uint16_t config_count;
+
+  if (pref_store_read(PREF_STORE_CONFIGS, preferences->rom_configs, 
+    sizeof(rom_config_record), MAX_ROM_CONFIGS, &config_count))
   {
-    free_ini_file(&file);
-    return nullptr;
+    if (errno == EPREFS)
+    {
+      add_rejected_store(rejected, sizeof(rejected), PREF_STORE_CONFIGS);
+    }
+
+    config_count = 0;
   }
-  
-  if (!add_key(
-    config_section, 
-    CONFIG_INI_SELECTED_PALETTE_KEY,
-    INI_TYPE_INT,
-    config->selected_palette
-  )) 
+
+  preferences->rom_config_count = config_count;
+  preferences->file_states.controls_changed = false;
+  preferences->file_states.stores_rejected = (rejected[0] != '\0');
+
+  if (preferences->file_states.stores_rejected)
   {
-    free_ini_file(&file);
-    return nullptr;
+    set_error_i(EPREFS, rejected);
   }
 
-  ini_write(&file, ini_string, len);
-  free_ini_file(&file);
-
-  return ini_string;
+  return 0;
 }
 
 uint8_t load_rom_config(struct gb_s *gb)
 {
   emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
 
-  uint32_t size;
-  char *ini_string;
-  char var_name[MAX_FILENAME_LEN];
-
-	get_rom_config_var_name(preferences, var_name);
   set_config_defaults(gb);
 
-  if (read_mcs(MCS_DIRECTORY, var_name, (void **)&ini_string, &size) == 0)
+  rom_config_record *record = find_rom_config(preferences, get_rom_config_hash(preferences));
+
+  if (record)
   {
-    if (process_config_ini(ini_string, size, gb) == 0)
-    {
-      return 0;
-    }
+    apply_rom_config(gb, &(record->config));
+    return 0;
+  }
+
+  // Take over the ini file of an older version once
+  if (import_rom_config_ini(gb) == 0)
+  {
+    return save_rom_config(gb);
   }
 
   // Restore defaults if read failed
@@ -223,18 +285,98 @@ uint8_t load_rom_config(struct gb_s *gb)
 uint8_t save_rom_config(struct gb_s *gb)
 {
   emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
+  rom_config_record *records = preferences->rom_configs;
 
-  char var_name[MAX_FILENAME_LEN];
-  char ini_string[INI_MAX_CONTENT_LEN];
+  const uint32_t rom_hash = get_rom_config_hash(preferences);
+  rom_config_record *record = find_rom_config(preferences, rom_hash);
+  uint8_t index = record ? (record - records) : preferences->rom_config_count;
 
-  get_rom_config_var_name(preferences, var_name);
-  
-  if (!create_config_ini(&(preferences->config), ini_string, INI_MAX_CONTENT_LEN)) 
+  // When the store is full, the config saved the longest time ago is dropped
+  if (index == MAX_ROM_CONFIGS)
   {
-    return 1;
+    index--;
+  }
+  else if (!record)
+  {
+    preferences->rom_config_count++;
   }
 
-  uint32_t size = align_val(strlen(ini_string), 4);
+  // Keep the most recent config in front
+  memmove(&(records[1]), &(records[0]), index * sizeof(rom_config_record));
 
-  return write_mcs(MCS_DIRECTORY, var_name, ini_string, size);
+  records[0].rom_hash = rom_hash;
+  records[0].config = preferences->config;
+
+  return pref_store_write(PREF_STORE_CONFIGS, records, sizeof(rom_config_record), 
+    preferences->rom_config_count);
+}
+
+uint8_t export_preferences_ini(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
+  uint8_t return_code = 0;
+
+  // The config of the running rom may not be stored yet
+  if (preferences->file_states.rom_config_changed)
+  {
+    return_code |= save_rom_config(gb);
+    preferences->file_states.rom_config_changed = false;
+  }
+
+  return_code |= export_controls_ini(&(preferences->controls));
+  return_code |= export_palettes_ini(preferences->stored_palettes, 
+    preferences->stored_palette_count);
+
+  for (uint8_t i = 0; i < preferences->rom_config_count; i++)
+  {
+    return_code |= export_rom_config_ini(&(preferences->rom_configs[i]));
+  }
+
+  return return_code;
+}
+
+uint8_t import_preferences_ini(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)(gb->direct.priv);
+  bool imported = false;
+
+  // Files that are incomplete must not change what is in use, so they are
+  // read into copies first
+  emu_controls controls;
+  palette pals[MAX_PALETTE_COUNT];
+  uint8_t pal_count;
+
+  if (import_controls_ini(&controls) == 0)
+  {
+    memcpy(preferences->controls, controls, sizeof(emu_controls));
+    save_controls(&(preferences->controls));
+    preferences->file_states.controls_changed = false;
+    imported = true;
+  }
+
+  if (import_palettes_ini(pals, &pal_count) == 0)
+  {
+    memcpy(preferences->stored_palettes, pals, pal_count * sizeof(palette));
+    preferences->stored_palette_count = pal_count;
+    save_user_palettes(preferences->stored_palettes, pal_count);
+    load_palettes(gb);
+    imported = true;
+  }
+
+  // Only the config of the running rom, the others are imported when their
+  // rom is started without a stored config
+  if (import_rom_config_ini(gb) == 0)
+  {
+    save_rom_config(gb);
+    preferences->file_states.rom_config_changed = false;
+    imported = true;
+  }
+
+  // The selected palette may be gone now
+  if (preferences->config.selected_palette >= preferences->palette_count) 
+  {
+    preferences->config.selected_palette = 0;
+  }
+
+  return !imported;
 }
@@ -3,35 +3,67 @@
 #include <stdint.h>
 #include "controls.h"
 #include "palettes.h"
+#include "scaler.h"
 #include "../helpers/macros.h"
 
 #define DEFAULT_INTERLACE_ENABLE  false
 #define DEFAULT_FRAMESKIP_ENABLE  false
 #define DEFAULT_FRAMESKIP_AMOUNT  1
+#define DEFAULT_FRAMESKIP_AUTO    false
+#define DEFAULT_FRAMESKIP_AUTO_AM 0
 #define DEFAULT_EMU_SPEED         100
 #define DEFAULT_OVERCLOCK_ENABLE  false
 #define DEFAULT_SELECTED_PALETTE  0
+#define DEFAULT_SCALER            SCALER_2X
+#define DEFAULT_LAZY_INPUT        false
+#define DEFAULT_REWIND_ENABLE     false
+#define DEFAULT_REWIND_INTERVAL   10
+#define DEFAULT_REWIND_BUFFER     4
+
+// Configs of the roms played last, older ones are dropped
+#define MAX_ROM_CONFIGS           64
+
+struct gb_bg_cache;
 
 typedef struct 
 {
   bool interlacing_enabled;
 
+  uint8_t scaler;
+
   bool frameskip_enabled;
   uint8_t frameskip_amount;
+  bool frameskip_auto;
+  uint8_t frameskip_auto_amount;
 
   uint16_t emulation_speed;
 
   bool overclock_enabled;
   
   uint8_t selected_palette;
+
+  bool lazy_input;
+
+  bool rewind_enabled;
+  uint8_t rewind_interval;
+  // Snapshot ring size in steps of REWIND_BUFFER_STEP
+  uint8_t rewind_buffer;
 } rom_config;
 
+typedef struct
+{
+  uint32_t rom_hash;
+  rom_config config;
+} rom_config_record;
+
 typedef struct 
 {
 	/* Pointer to allocated memory holding GB file. */
 	uint8_t *rom;
 	/* Pointer to allocated memory holding save file. */
 	uint8_t *cart_ram;
+	/* Pointer to allocated memory holding decoded background maps. */
+	struct gb_bg_cache *bg_cache;
 
   char current_filename[200];
   char current_rom_name[16];
@@ -44,13 +76,28 @@ typedef struct
   emu_controls controls;
   rom_config config;
 
+  // Loaded once per session by load_preferences()
+  palette *stored_palettes;
+  uint8_t stored_palette_count;
+  // Most recently saved first
+  rom_config_record *rom_configs;
+  uint8_t rom_config_count;
+
   struct 
   {
     bool controls_changed;
     bool rom_config_changed;
+    bool stores_rejected;
   } file_states;
 } emu_preferences;
 
+uint8_t load_preferences(emu_preferences *preferences);
+
 uint8_t load_rom_config(struct gb_s *gb);
 
 uint8_t save_rom_config(struct gb_s *gb);
+
+// Ini files are only written or read when the user asks for it
+uint8_t export_preferences_ini(struct gb_s *gb);
+
+uint8_t import_preferences_ini(struct gb_s *gb);
@@ -0,0 +1,404 @@
+#include "rewind.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "../cas/cpu/tmu.h"
+
+// Snapshots are the emulator context and memory, kept as 32 bit words. 
+// The last snapshot is kept as it is, older ones only as the XOR delta 
+// to the snapshot after them. Deltas are run length encoded: a header 
+// word holds the number of unchanged words in the upper and the number 
+// of changed words in the lower half, followed by the changed words.
+#define RUN_MAX 0xFFFF
+
+#define SECTION_COUNT 6
+
+typedef struct
+{
+  uint32_t *data;
+  uint32_t words;
+} rewind_section;
+
+static bool enabled = false;
+static uint8_t interval = 1;
+static uint8_t frames_since_snapshot = 0;
+
+static rewind_section sections[SECTION_COUNT];
+
+// The last snapshot, its sections in order, and the context it is 
+// restored through
+static uint32_t *snapshot = nullptr;
+static uint32_t snapshot_words = 0;
+static struct gb_s *state = nullptr;
+
+// Ring of deltas, oldest first
+static uint32_t *ring = nullptr;
+static uint32_t ring_words = 0;
+static uint32_t ring_start = 0;
+static uint32_t ring_used = 0;
+
+static uint32_t entry_words[REWIND_MAX_SNAPSHOTS];
+static uint16_t entry_first = 0;
+static uint16_t entry_count = 0;
+
+static uint16_t snapshot_avg = 0;
+static uint16_t snapshot_max = 0;
+
+// Lists the memory a snapshot is made of, in snapshot order. All sizes 
+// are multiples of 4 and all memory is word aligned.
+static void get_sections(struct gb_s *gb)
+{
+  sections[0] = { (uint32_t *)state, sizeof(struct gb_s) / 4 };
+  sections[1] = { (uint32_t *)gb->wram, WRAM_SIZE / 4 };
+  sections[2] = { (uint32_t *)gb->vram, VRAM_SIZE / 4 };
+  sections[3] = { (uint32_t *)gb->oam, OAM_SIZE / 4 };
+  sections[4] = { (uint32_t *)gb->hram_io, HRAM_IO_SIZE / 4 };
+  sections[5] = { (uint32_t *)gb->cram, (uint32_t)(gb->cram_size / 4) };
+}
+
+static void drop_oldest()
+{
+  ring_start = (ring_start + entry_words[entry_first]) % ring_words;
+  ring_used -= entry_words[entry_first];
+
+  entry_first = (entry_first + 1) % REWIND_MAX_SNAPSHOTS;
+  entry_count--;
+}
+
+static void clear_ring()
+{
+  ring_start = 0;
+  ring_used = 0;
+  entry_first = 0;
+  entry_count = 0;
+}
+
+// Appends a word to the delta being written, dropping old deltas to make 
+// room. Fails once the delta alone fills the ring.
+static inline bool put_word(uint32_t word, uint32_t *len)
+{
+  if (ring_used + *len == ring_words)
+  {
+    if (entry_count == 0)
+    {
+      return false;
+    }
+
+    drop_oldest();
+  }
+
+  ring[(ring_start + ring_used + *len) % ring_words] = word;
+  (*len)++;
+
+  return true;
+}
+
+// Writes the delta of a section to the ring and updates the snapshot
+static bool write_delta(const uint32_t *src, uint32_t *dst, uint32_t words, uint32_t *len, 
+  bool fits)
+{
+  uint32_t i = 0;
+
+  while (i < words)
+  {
+    uint32_t start = i;
+
+    while (i < words && src[i] == dst[i] && i - start < RUN_MAX)
+    {
+      i++;
+    }
+
+    const uint32_t unchanged = i - start;
+    start = i;
+
+    while (i < words && src[i] != dst[i] && i - start < RUN_MAX)
+    {
+      i++;
+    }
+
+    fits = fits && put_word((unchanged << 16) | (i - start), len);
+
+    for (uint32_t j = start; j < i; j++)
+    {
+      fits = fits && put_word(src[j] ^ dst[j], len);
+      dst[j] = src[j];
+    }
+  }
+
+  return fits;
+}
+
+static void take_snapshot(struct gb_s *gb)
+{
+  const uint32_t start_time = tmu_clock();
+  uint32_t *dst = snapshot;
+  uint32_t len = 0;
+  bool fits = true;
+
+  if (entry_count == REWIND_MAX_SNAPSHOTS)
+  {
+    drop_oldest();
+  }
+
+  gb_save_state(gb, state);
+
+  for (uint8_t i = 0; i < SECTION_COUNT; i++)
+  {
+    fits = write_delta(sections[i].data, dst, sections[i].words, &len, fits);
+    dst += sections[i].words;
+  }
+
+  if (fits)
+  {
+    entry_words[(entry_first + entry_count) % REWIND_MAX_SNAPSHOTS] = len;
+    entry_count++;
+    ring_used += len;
+  }
+  else 
+  {
+    // Changed too much for the ring, the older snapshots can not be 
+    // reached anymore
+    clear_ring();
+  }
+
+  const uint32_t time = tmu_ticks_to_tenth_ms(tmu_clock() - start_time);
+
+  snapshot_avg = (snapshot_avg * 7 + time) / 8;
+  snapshot_max = (time > snapshot_max)? time : snapshot_max;
+}
+
+// Applies the newest delta to the snapshot and drops it from the ring
+static void undo_delta()
+{
+  const uint16_t entry = (entry_first + entry_count - 1) % REWIND_MAX_SNAPSHOTS;
+  const uint32_t len = entry_words[entry];
+  uint32_t pos = (ring_start + ring_used - len) % ring_words;
+  uint32_t *dst = snapshot;
+
+  for (uint32_t read = 0; read < len;)
+  {
+    const uint32_t header = ring[pos];
+    uint32_t changed = header & RUN_MAX;
+
+    pos = (pos + 1) % ring_words;
+    read++;
+    dst += header >> 16;
+
+    while (changed--)
+    {
+      *dst++ ^= ring[pos];
+      pos = (pos + 1) % ring_words;
+      read++;
+    }
+  }
+
+  ring_used -= len;
+  entry_count--;
+}
+
+// Marks the cart ram pages that differ from the snapshot
+static bool mark_cram_changes(struct gb_s *gb, const uint32_t *src, uint32_t dirty[CRAM_DIRTY_WORDS])
+{
+  const uint32_t *cram = (const uint32_t *)gb->cram;
+  const uint32_t page_words = CRAM_DIRTY_PAGE_SIZE / 4;
+  const uint32_t words = gb->cram_size / 4;
+  bool changed = false;
+
+  for (uint32_t start = 0; start < words; start += page_words)
+  {
+    const uint32_t len = (words - start < page_words)? words - start : page_words;
+
+    if (memcmp(&cram[start], &src[start], len * 4) != 0)
+    {
+      const uint32_t page = start / page_words;
+
+      dirty[page >> 5] |= 1UL << (page & 31);
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+static void restore_snapshot(struct gb_s *gb)
+{
+  const uint32_t *src = snapshot;
+  uint32_t cram_dirty[CRAM_DIRTY_WORDS] = { 0 };
+  bool cram_changed = false;
+
+  // The context goes through gb_restore_state(), the memory is copied back
+  for (uint8_t i = 0; i < SECTION_COUNT; i++)
+  {
+    if (sections[i].data == (uint32_t *)gb->cram)
+    {
+      cram_changed = mark_cram_changes(gb, src, cram_dirty);
+    }
+
+    memcpy(sections[i].data, src, sections[i].words * 4);
+    src += sections[i].words;
+  }
+
+  // Only the pages the rewind changed have to be saved again, so holding
+  // rewind does not keep the autosave writing
+  gb_restore_state(gb, state);
+
+  if (cram_changed)
+  {
+    for (uint8_t i = 0; i < CRAM_DIRTY_WORDS; i++)
+    {
+      gb->cram_dirty[i] |= cram_dirty[i];
+    }
+
+    gb->cram_writes++;
+  }
+}
+
+uint8_t rewind_open(struct gb_s *gb, uint8_t interval_frames, uint32_t ring_size)
+{
+  interval = interval_frames;
+
+  if (enabled && ring_words * 4 == ring_size)
+  {
+    return 0;
+  }
+
+  rewind_close();
+
+  state = (struct gb_s *)malloc(sizeof(struct gb_s));
+
+  if (!state)
+  {
+    set_error(EMALLOC);
+    return 1;
+  }
+
+  get_sections(gb);
+
+  snapshot_words = 0;
+
+  for (uint8_t i = 0; i < SECTION_COUNT; i++)
+  {
+    snapshot_words += sections[i].words;
+  }
+
+  snapshot = (uint32_t *)malloc(snapshot_words * 4);
+
+  // Use a smaller ring if the requested one does not fit
+  while (snapshot && !ring && ring_size >= REWIND_BUFFER_STEP)
+  {
+    ring = (uint32_t *)malloc(ring_size);
+
+    if (!ring)
+    {
+      ring_size /= 2;
+    }
+  }
+
+  if (!snapshot || !ring)
+  {
+    rewind_close();
+    set_error(EMALLOC);
+    return 1;
+  }
+
+  ring_words = ring_size / 4;
+  clear_ring();
+
+  // Start from a full snapshot, later ones only store what changed
+  gb_save_state(gb, state);
+
+  uint32_t *dst = snapshot;
+
+  for (uint8_t i = 0; i < SECTION_COUNT; i++)
+  {
+    memcpy(dst, sections[i].data, sections[i].words * 4);
+    dst += sections[i].words;
+  }
+
+  frames_since_snapshot = 0;
+  snapshot_avg = 0;
+  snapshot_max = 0;
+  enabled = true;
+
+  tmu_start_clock();
+
+  return 0;
+}
+
+void rewind_close()
+{
+  free(ring);
+  free(snapshot);
+  free(state);
+
+  ring = nullptr;
+  snapshot = nullptr;
+  state = nullptr;
+  ring_words = 0;
+  snapshot_words = 0;
+  enabled = false;
+
+  clear_ring();
+}
+
+bool rewind_enabled()
+{
+  return enabled;
+}
+
+void rewind_frame(struct gb_s *gb)
+{
+  if (!enabled)
+  {
+    return;
+  }
+
+  if (++frames_since_snapshot < interval)
+  {
+    return;
+  }
+
+  frames_since_snapshot = 0;
+  take_snapshot(gb);
+}
+
+bool rewind_step(struct gb_s *gb)
+{
+  bool stepped = true;
+
+  if (!enabled)
+  {
+    return false;
+  }
+
+  // Go back to the last snapshot first if the game ran since
+  if (frames_since_snapshot == 0)
+  {
+    if (entry_count > 0)
+    {
+      undo_delta();
+    }
+    else 
+    {
+      stepped = false;
+    }
+  }
+
+  frames_since_snapshot = 0;
+  restore_snapshot(gb);
+
+  return stepped;
+}
+
+void rewind_get_stats(rewind_stats *stats)
+{
+  stats->snapshots = entry_count;
+  stats->frames = entry_count * interval;
+  stats->ring_used = ring_used * 4;
+  stats->ring_size = ring_words * 4;
+  stats->memory = (enabled)? 
+    ring_words * 4 + snapshot_words * 4 + sizeof(struct gb_s) : 0;
+  stats->snapshot_avg = snapshot_avg;
+  stats->snapshot_max = snapshot_max;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include "peanut_gb_header.h"
+
+// Frames between two snapshots
+#define REWIND_INTERVAL_MIN 1
+#define REWIND_INTERVAL_MAX 60
+
+// Size of the snapshot ring in steps of REWIND_BUFFER_STEP bytes
+#define REWIND_BUFFER_STEP  (128 * 1024)
+#define REWIND_BUFFER_MIN   1
+#define REWIND_BUFFER_MAX   16
+
+#define REWIND_MAX_SNAPSHOTS 1024
+
+typedef struct
+{
+  // Snapshots that can be restored and the frames they go back
+  uint16_t snapshots;
+  uint32_t frames;
+  // Bytes of the ring in use, the ring size and all memory allocated
+  uint32_t ring_used;
+  uint32_t ring_size;
+  uint32_t memory;
+  // Time a snapshot takes in tenths of a millisecond
+  uint16_t snapshot_avg;
+  uint16_t snapshot_max;
+} rewind_stats;
+
+/**
+ * Allocates the snapshot ring and takes the first snapshot. An open ring 
+ * of the same size only gets the new interval and keeps its snapshots.
+ * If the ring does not fit into memory, a smaller one is used.
+ * 
+ * @param interval    Frames between two snapshots
+ * @param ring_size   Size of the snapshot ring in bytes
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t rewind_open(struct gb_s *gb, uint8_t interval, uint32_t ring_size);
+
+void rewind_close();
+
+bool rewind_enabled();
+
+// Takes a snapshot every interval frames, call after every emulated frame
+void rewind_frame(struct gb_s *gb);
+
+/**
+ * Restores the last snapshot, or the one before it if the emulator did 
+ * not run since the last snapshot was restored or taken. 
+ * 
+ * @return Returns false once the oldest snapshot is reached
+*/
+bool rewind_step(struct gb_s *gb);
+
+void rewind_get_stats(rewind_stats *stats);
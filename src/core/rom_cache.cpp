@@ -0,0 +1,431 @@
+#include "rom_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sdk/os/file.hpp>
+#include "error.h"
+#include "palettes.h"
+#include "../cas/cpu/stack.h"
+#include "../helpers/arena.h"
+#include "../helpers/functions.h"
+#include "../helpers/lz4.h"
+#include "../helpers/macros.h"
+
+#define ROM_CACHE_MAX_BANKS 512
+
+// Packed ROMs start with this header, followed by the file offset of every
+// bank and the end offset of the last bank. All values are little endian.
+#define GBZ_MAGIC       "GBZ1"
+#define GBZ_HEADER_SIZE 12
+
+static int32_t rom_fd = -1;
+
+// Offsets of the compressed banks, and the buffer they are read to
+static bool packed = false;
+static uint32_t packed_offsets[ROM_CACHE_MAX_BANKS + 1];
+static uint8_t *packed_buf = nullptr;
+
+// Buffers are taken from the rom arena and given back when the rom is closed
+static uint8_t *bank0 = nullptr;
+static uint8_t *pool = nullptr;
+static uint8_t slot_count = 0;
+static uint16_t bank_count = 0;
+
+// Resident slot of every bank, and the bank and last use of every slot
+static uint8_t bank_slot[ROM_CACHE_MAX_BANKS];
+static uint16_t slot_bank[ROM_CACHE_MAX_SLOTS];
+static uint32_t slot_used[ROM_CACHE_MAX_SLOTS];
+static uint32_t use_counter = 0;
+
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+
+// The stack the frame was started from, while it runs on the small one
+static void *file_stack = nullptr;
+
+// Set by a bank that could not be read while the game was running
+static bool read_failed = false;
+static uint16_t failed_bank = 0;
+
+static uint32_t read_le32(const uint8_t *buf)
+{
+  return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint8_t read_packed_bank(uint16_t bank, uint8_t *buf)
+{
+  const uint32_t len = packed_offsets[bank + 1] - packed_offsets[bank];
+
+  if (len > ROM_CACHE_BANK_SIZE)
+  {
+    return 1;
+  }
+
+  if (lseek(rom_fd, packed_offsets[bank], SEEK_SET) < 0)
+  {
+    return 1;
+  }
+
+  // Banks that did not get smaller are stored as they are
+  if (len == ROM_CACHE_BANK_SIZE)
+  {
+    return (read(rom_fd, buf, len) == (int32_t)len)? 0 : 1;
+  }
+
+  if (read(rom_fd, packed_buf, len) != (int32_t)len)
+  {
+    return 1;
+  }
+
+  if (lz4_decompress(packed_buf, len, buf, ROM_CACHE_BANK_SIZE) != ROM_CACHE_BANK_SIZE)
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+// Reads the header and bank index of a packed ROM
+static uint8_t read_packed_index()
+{
+  uint8_t header[GBZ_HEADER_SIZE];
+  uint8_t entry[4];
+
+  if (read(rom_fd, header, sizeof(header)) != sizeof(header))
+  {
+    return 1;
+  }
+
+  bank_count = header[8] | (header[9] << 8);
+
+  if (bank_count < 2 || bank_count > ROM_CACHE_MAX_BANKS)
+  {
+    return 1;
+  }
+
+  for (uint16_t i = 0; i <= bank_count; i++)
+  {
+    if (read(rom_fd, entry, sizeof(entry)) != sizeof(entry))
+    {
+      return 1;
+    }
+
+    packed_offsets[i] = read_le32(entry);
+
+    if (i > 0 && packed_offsets[i] < packed_offsets[i - 1])
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t read_bank(uint16_t bank, uint8_t *buf)
+{
+  if (packed)
+  {
+    return read_packed_bank(bank, buf);
+  }
+
+  if (lseek(rom_fd, bank * ROM_CACHE_BANK_SIZE, SEEK_SET) < 0)
+  {
+    return 1;
+  }
+
+  // The last bank of a ROM may be cut short
+  int32_t len = read(rom_fd, buf, ROM_CACHE_BANK_SIZE);
+
+  if (len < 0)
+  {
+    return 1;
+  }
+
+  memset(buf + len, 0xFF, ROM_CACHE_BANK_SIZE - len);
+
+  return 0;
+}
+
+// The file calls of the os need more stack than the 4KB the frames run on, 
+// so a bank is read on the stack the frame was started from. Everything 
+// below its stack pointer is unused until the frame returns.
+static uint8_t __attribute__((noinline)) read_bank_on_file_stack(uint16_t bank, uint8_t *buf)
+{
+  if (!file_stack)
+  {
+    return read_bank(bank, buf);
+  }
+
+  void *stack_ptr_bak = get_stack_ptr();
+  set_stack_ptr(file_stack);
+
+  const uint8_t ret = read_bank(bank, buf);
+
+  set_stack_ptr(stack_ptr_bak);
+
+  return ret;
+}
+
+// Memory prepare_emulator() takes from the rom arena after the pool: the 
+// decoded background maps, cart ram with the rtc and the palettes. One 
+// block more covers what the arena loses at block ends.
+static uint32_t get_rom_headroom(const uint8_t *rom)
+{
+  const uint32_t ram_sizes[] = { 0x00, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+  const uint8_t cart_type = rom[0x0147];
+  const uint8_t ram_size = rom[0x0149];
+
+  uint32_t cram_size = (ram_size < sizeof(ram_sizes) / sizeof(ram_sizes[0]))
+    ? ram_sizes[ram_size] : CRAM_MAX_SIZE;
+
+  // MBC2 always has 512 half-bytes of cart ram
+  if (cart_type == 0x05 || cart_type == 0x06)
+  {
+    cram_size = 0x200;
+  }
+
+  return sizeof(struct gb_bg_cache) 
+    + cram_size + sizeof(((struct gb_s *)0)->cart_rtc)
+    + (2 + MAX_PALETTE_COUNT) * sizeof(palette)
+    + ARENA_BLOCK_SIZE;
+}
+
+uint8_t rom_cache_open(const char *file, uint8_t **rom)
+{
+  char err_info[ERROR_MAX_INFO_LEN];
+  char tmp[20];
+  struct stat file_stat;
+
+  strlcpy(err_info, "r: ", sizeof(err_info));
+  strlcat(err_info, file, sizeof(err_info));
+
+  rom_fd = open(file, OPEN_READ);
+
+  if (rom_fd < 0)
+  {
+    set_error_i(EFOPEN, err_info);
+    return 1;
+  }
+
+  if (fstat(rom_fd, &file_stat) < 0)
+  {
+    rom_cache_close();
+    set_error_i(EFREAD, err_info);
+    return 1;
+  }
+
+  char magic[sizeof(GBZ_MAGIC) - 1];
+
+  packed = (read(rom_fd, magic, sizeof(magic)) == sizeof(magic))
+    && memcmp(magic, GBZ_MAGIC, sizeof(magic)) == 0;
+
+  if (packed)
+  {
+    packed_buf = (uint8_t *)arena_alloc(&rom_arena, ROM_CACHE_BANK_SIZE);
+
+    if (!packed_buf)
+    {
+      rom_cache_close();
+      set_error_i(EMALLOC, "Packed bank: 16384B");
+      return 1;
+    }
+
+    if (lseek(rom_fd, 0, SEEK_SET) < 0 || read_packed_index() != 0)
+    {
+      rom_cache_close();
+      set_error_i(EFREAD, err_info);
+      return 1;
+    }
+  }
+  else
+  {
+    bank_count = clamp(
+      (uint32_t)((file_stat.fileSize + ROM_CACHE_BANK_SIZE - 1) / ROM_CACHE_BANK_SIZE), 
+      (uint32_t)2, 
+      (uint32_t)ROM_CACHE_MAX_BANKS
+    );
+  }
+
+  bank0 = (uint8_t *)arena_alloc(&rom_arena, ROM_CACHE_BANK_SIZE);
+
+  if (!bank0)
+  {
+    rom_cache_close();
+    set_error_i(EMALLOC, "GB ROM: 16384B");
+    return 1;
+  }
+
+  if (read_bank(0, bank0) != 0)
+  {
+    rom_cache_close();
+    set_error_i(EFREAD, err_info);
+    return 1;
+  }
+
+  // Use the largest pool that still leaves room for what the rom takes 
+  // after it. If the full pool does not fit, only use half of what did, so
+  // the buffers that are allocated later on still fit as well.
+  uint8_t wanted_slots = clamp((uint16_t)(bank_count - 1), (uint16_t)1, (uint16_t)ROM_CACHE_MAX_SLOTS);
+  const uint32_t headroom = get_rom_headroom(bank0);
+
+  // Arena memory cannot be given back on its own, so the heap is probed 
+  // before the pool is taken from the arena.
+  for (slot_count = wanted_slots; slot_count >= ROM_CACHE_MIN_SLOTS; slot_count /= 2)
+  {
+    void *probe = malloc(slot_count * ROM_CACHE_BANK_SIZE + headroom);
+
+    if (probe)
+    {
+      free(probe);
+      break;
+    }
+  }
+
+  if (slot_count != wanted_slots && slot_count / 2 >= ROM_CACHE_MIN_SLOTS)
+  {
+    slot_count /= 2;
+  }
+
+  if (slot_count >= ROM_CACHE_MIN_SLOTS)
+  {
+    pool = (uint8_t *)arena_alloc(&rom_arena, slot_count * ROM_CACHE_BANK_SIZE);
+  }
+
+  if (!pool)
+  {
+    rom_cache_close();
+
+    strlcpy(err_info, "ROM banks: ", sizeof(err_info));
+    strlcat(err_info, itoa(ROM_CACHE_MIN_SLOTS * ROM_CACHE_BANK_SIZE, tmp, 10), sizeof(err_info));
+    strlcat(err_info, "B", sizeof(err_info));
+
+    set_error_i(EMALLOC, err_info);
+    return 1;
+  }
+
+  memset(bank_slot, ROM_CACHE_NO_SLOT, sizeof(bank_slot));
+
+  for (uint8_t i = 0; i < slot_count; i++)
+  {
+    slot_bank[i] = 0;
+    slot_used[i] = 0;
+  }
+
+  use_counter = 0;
+  hits = 0;
+  misses = 0;
+  read_failed = false;
+
+  *rom = bank0;
+
+  return 0;
+}
+
+void rom_cache_close()
+{
+  if (rom_fd >= 0)
+  {
+    close(rom_fd);
+    rom_fd = -1;
+  }
+
+  // The buffers go back with the rest of the rom arena
+  bank0 = nullptr;
+  pool = nullptr;
+  packed_buf = nullptr;
+  packed = false;
+  slot_count = 0;
+}
+
+uint8_t *rom_cache_bank(struct gb_s *gb, const uint_fast16_t bank)
+{
+  (void)gb;
+
+  const uint16_t index = bank % bank_count;
+
+  if (index == 0)
+  {
+    return bank0;
+  }
+
+  uint8_t slot = bank_slot[index];
+
+  if (likely(slot != ROM_CACHE_NO_SLOT))
+  {
+    hits++;
+    slot_used[slot] = ++use_counter;
+
+    return pool + (slot * ROM_CACHE_BANK_SIZE);
+  }
+
+  misses++;
+
+  // Replace the least recently used bank, unused slots were never used
+  slot = 0;
+
+  for (uint8_t i = 1; i < slot_count; i++)
+  {
+    if (slot_used[i] < slot_used[slot])
+    {
+      slot = i;
+    }
+  }
+
+  if (slot_used[slot] != 0)
+  {
+    bank_slot[slot_bank[slot]] = ROM_CACHE_NO_SLOT;
+  }
+
+  uint8_t *buf = pool + (slot * ROM_CACHE_BANK_SIZE);
+
+  // The bank is not kept when the read fails, so the next access tries
+  // again. Until the game is stopped after the frame it sees open bus values.
+  if (read_bank_on_file_stack(index, buf) != 0)
+  {
+    memset(buf, 0xFF, ROM_CACHE_BANK_SIZE);
+
+    slot_used[slot] = 0;
+    read_failed = true;
+    failed_bank = index;
+
+    return buf;
+  }
+
+  bank_slot[index] = slot;
+  slot_bank[slot] = index;
+  slot_used[slot] = ++use_counter;
+
+  return buf;
+}
+
+void rom_cache_set_file_stack(void *stack_ptr)
+{
+  file_stack = stack_ptr;
+}
+
+uint8_t rom_cache_check_reads()
+{
+  if (likely(!read_failed))
+  {
+    return 0;
+  }
+
+  char err_info[ERROR_MAX_INFO_LEN];
+  char tmp[12];
+
+  strlcpy(err_info, "ROM bank ", sizeof(err_info));
+  strlcat(err_info, itoa(failed_bank, tmp, 10), sizeof(err_info));
+
+  read_failed = false;
+  set_error_i(EFREAD, err_info);
+
+  return 1;
+}
+
+void rom_cache_get_stats(rom_cache_stats *stats)
+{
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->banks = bank_count;
+  stats->slots = slot_count;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "peanut_gb_header.h"
+
+#define ROM_CACHE_BANK_SIZE 0x4000
+
+// Switchable banks kept in memory at most, banks of smaller ROMs are all 
+// kept once they were loaded
+#define ROM_CACHE_MAX_SLOTS 64
+#define ROM_CACHE_MIN_SLOTS 1
+
+#define ROM_CACHE_NO_SLOT   0xFF
+
+typedef struct
+{
+  uint32_t hits;
+  uint32_t misses;
+  uint16_t banks;
+  uint8_t slots;
+} rom_cache_stats;
+
+/**
+ * Opens a raw or packed (.gbz) ROM file, loads bank 0 and allocates the 
+ * bank pool. The file stays open until rom_cache_close() is called.
+ * 
+ * @param file  The ROM file
+ * @param rom   Set to bank 0, which stays in memory
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t rom_cache_open(const char *file, uint8_t **rom);
+
+void rom_cache_close();
+
+// Returns the given switchable bank, loads it from the file if needed
+uint8_t *rom_cache_bank(struct gb_s *gb, const uint_fast16_t bank);
+
+// Banks are read on this stack while it is set, nullptr reads on the current
+void rom_cache_set_file_stack(void *stack_ptr);
+
+/**
+ * Checks if a bank could not be read since the last check. The game ran on
+ * open bus values then and has to be stopped.
+ * 
+ * @return Returns 0 if every bank was read else an error occured
+*/
+uint8_t rom_cache_check_reads();
+
+void rom_cache_get_stats(rom_cache_stats *stats);
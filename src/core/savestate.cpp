@@ -0,0 +1,393 @@
+#include "savestate.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sdk/os/file.hpp>
+#include "cart_ram.h"
+#include "error.h"
+#include "../helpers/fileio.h"
+#include "../helpers/functions.h"
+#include "../helpers/lz4.h"
+#include "../helpers/macros.h"
+
+#define SAVESTATE_MAGIC "CPBS"
+
+// Every chunk starts with its raw and stored size. A chunk that did not get
+// smaller is stored as it is, with both sizes equal.
+#define CHUNK_HEADER_SIZE 4
+
+
+// States are only read on the calculator that wrote them, so values are 
+// stored in native byte order
+typedef struct
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t context_size;
+  uint16_t rom_checksum;
+  uint8_t rom_header_checksum;
+  uint8_t reserved;
+  uint32_t cram_size;
+} savestate_header;
+
+typedef struct
+{
+  uint8_t *data;
+  uint32_t len;
+} savestate_section;
+
+// Lists the memory stored after the context, in file order
+static uint8_t get_sections(struct gb_s *gb, savestate_section *sections)
+{
+  sections[0] = { gb->wram, WRAM_SIZE };
+  sections[1] = { gb->vram, VRAM_SIZE };
+  sections[2] = { gb->oam, OAM_SIZE };
+  sections[3] = { gb->hram_io, HRAM_IO_SIZE };
+  sections[4] = { gb->cram, (uint32_t)gb->cram_size };
+
+  return 5;
+}
+
+static void fill_header(struct gb_s *gb, savestate_header *header)
+{
+  memcpy(header->magic, SAVESTATE_MAGIC, sizeof(header->magic));
+  header->version = SAVESTATE_VERSION;
+  header->context_size = sizeof(struct gb_s);
+  header->rom_checksum = (gb->rom[ROM_HEADER_CHECKSUM_LOC + 1] << 8) 
+    | gb->rom[ROM_HEADER_CHECKSUM_LOC + 2];
+  header->rom_header_checksum = gb->rom[ROM_HEADER_CHECKSUM_LOC];
+  header->reserved = 0;
+  header->cram_size = gb->cram_size;
+}
+
+// Compresses data chunk by chunk and writes it to the file
+static uint8_t write_section(int32_t fd, const uint8_t *data, uint32_t len, uint8_t *buf, 
+  uint16_t *table)
+{
+  while (len > 0)
+  {
+    const uint16_t raw_len = (len > SAVESTATE_CHUNK_SIZE)? SAVESTATE_CHUNK_SIZE : len;
+    const int32_t compressed = lz4_compress(data, raw_len, buf + CHUNK_HEADER_SIZE, 
+      raw_len - 1, table);
+    uint16_t packed_len = compressed;
+
+    if (compressed < 0)
+    {
+      packed_len = raw_len;
+      memcpy(buf + CHUNK_HEADER_SIZE, data, raw_len);
+    }
+
+    memcpy(buf, &raw_len, sizeof(raw_len));
+    memcpy(buf + sizeof(raw_len), &packed_len, sizeof(packed_len));
+
+    if (write(fd, buf, CHUNK_HEADER_SIZE + packed_len) != CHUNK_HEADER_SIZE + packed_len)
+    {
+      return 1;
+    }
+
+    data += raw_len;
+    len -= raw_len;
+  }
+
+  return 0;
+}
+
+// Reads and decompresses a section written by write_section()
+static uint8_t read_section(int32_t fd, uint8_t *data, uint32_t len, uint8_t *buf)
+{
+  while (len > 0)
+  {
+    uint16_t sizes[2];
+
+    if (read(fd, sizes, sizeof(sizes)) != sizeof(sizes))
+    {
+      return 1;
+    }
+
+    const uint16_t raw_len = sizes[0];
+    const uint16_t packed_len = sizes[1];
+
+    if (raw_len > len || raw_len > SAVESTATE_CHUNK_SIZE || packed_len > raw_len)
+    {
+      return 1;
+    }
+
+    if (packed_len == raw_len)
+    {
+      if (read(fd, data, raw_len) != raw_len)
+      {
+        return 1;
+      }
+    }
+    else 
+    {
+      if (read(fd, buf, packed_len) != packed_len)
+      {
+        return 1;
+      }
+
+      if (lz4_decompress(buf, packed_len, data, raw_len) != raw_len)
+      {
+        return 1;
+      }
+    }
+
+    data += raw_len;
+    len -= raw_len;
+  }
+
+  return 0;
+}
+
+char *get_state_path(emu_preferences *preferences, const char *extension, 
+  char *path_buffer, size_t len)
+{
+  strlcpy(path_buffer, DIRECTORY_SAVES "\\", len);
+  strlcat(path_buffer, preferences->current_filename, len);
+
+  // Replace the rom extension
+  char *rom_extension = strrchr(path_buffer, '.');
+
+  if (rom_extension && rom_extension > strrchr(path_buffer, '\\'))
+  {
+    *rom_extension = '\0';
+  }
+
+  strlcat(path_buffer, extension, len);
+
+  return path_buffer;
+}
+
+uint8_t write_state_file(struct gb_s *gb, const char *path)
+{
+  char err_info[ERROR_MAX_INFO_LEN];
+
+  strlcpy(err_info, "w: ", sizeof(err_info));
+  strlcat(err_info, path, sizeof(err_info));
+
+  savestate_header header;
+  savestate_section sections[5];
+  const uint8_t section_count = get_sections(gb, sections);
+
+  fill_header(gb, &header);
+
+  // Context copy, chunk buffer and compressor table in one allocation
+  uint8_t *work = (uint8_t *)malloc(sizeof(struct gb_s) + CHUNK_HEADER_SIZE 
+    + SAVESTATE_CHUNK_SIZE + LZ4_TABLE_SIZE * sizeof(uint16_t));
+
+  if (!work)
+  {
+    set_error(EMALLOC);
+    return 1;
+  }
+
+  struct gb_s *state = (struct gb_s *)work;
+  uint16_t *table = (uint16_t *)(work + sizeof(struct gb_s));
+  uint8_t *buf = (uint8_t *)(table + LZ4_TABLE_SIZE);
+
+  gb_save_state(gb, state);
+
+  // Saves folder might not exist yet
+  mkdir(DIRECTORY_SAVES);
+
+  int32_t fd = open(path, OPEN_WRITE | OPEN_CREATE);
+
+  if (fd < 0)
+  {
+    free(work);
+    set_error_i(EFOPEN, err_info);
+    return 1;
+  }
+
+  uint8_t ret = (write(fd, &header, sizeof(header)) != sizeof(header));
+
+  if (!ret)
+  {
+    ret = write_section(fd, (uint8_t *)state, sizeof(struct gb_s), buf, table);
+  }
+
+  for (uint8_t i = 0; i < section_count && !ret; i++)
+  {
+    ret = write_section(fd, sections[i].data, sections[i].len, buf, table);
+  }
+
+  free(work);
+
+  if (ret)
+  {
+    close(fd);
+    set_error_i(EFWRITE, err_info);
+    return 1;
+  }
+
+  if (close(fd) < 0)
+  {
+    set_error_i(EFCLOSE, err_info);
+    return 1;
+  }
+
+  return 0;
+}
+
+uint8_t read_state_file(struct gb_s *gb, const char *path)
+{
+  char err_info[ERROR_MAX_INFO_LEN];
+
+  strlcpy(err_info, "r: ", sizeof(err_info));
+  strlcat(err_info, path, sizeof(err_info));
+
+  int32_t fd = open(path, OPEN_READ);
+
+  if (fd < 0)
+  {
+    set_error_i(EFOPEN, err_info);
+    return STATE_READ_REFUSED;
+  }
+
+  savestate_header header;
+  savestate_header expected;
+
+  fill_header(gb, &expected);
+
+  if (read(fd, &header, sizeof(header)) != sizeof(header))
+  {
+    close(fd);
+    set_error_i(EFREAD, err_info);
+    return STATE_READ_REFUSED;
+  }
+
+  if (memcmp(&header, &expected, sizeof(header)))
+  {
+    close(fd);
+    set_error_i(ESTATE, err_info);
+    return STATE_READ_REFUSED;
+  }
+
+  uint8_t *work = (uint8_t *)malloc(sizeof(struct gb_s) + SAVESTATE_CHUNK_SIZE);
+
+  if (!work)
+  {
+    close(fd);
+    set_error(EMALLOC);
+    return STATE_READ_REFUSED;
+  }
+
+  struct gb_s *state = (struct gb_s *)work;
+  uint8_t *buf = work + sizeof(struct gb_s);
+
+  savestate_section sections[5];
+  const uint8_t section_count = get_sections(gb, sections);
+
+  // The context is only applied once all memory was read
+  uint8_t ret = read_section(fd, (uint8_t *)state, sizeof(struct gb_s), buf);
+
+  for (uint8_t i = 0; i < section_count && !ret; i++)
+  {
+    ret = read_section(fd, sections[i].data, sections[i].len, buf);
+  }
+
+  if (!ret)
+  {
+    gb_load_state(gb, state);
+  }
+
+  free(work);
+  close(fd);
+
+  if (ret)
+  {
+    set_error_i(EFREAD, err_info);
+    return STATE_READ_BROKEN;
+  }
+
+  return STATE_READ_OK;
+}
+
+char *get_savestate_path(emu_preferences *preferences, uint8_t slot, char *path_buffer, 
+  size_t len)
+{
+  char extension[] = EXTENSION_SAVESTATE "0";
+
+  extension[sizeof(extension) - 2] += slot;
+
+  return get_state_path(preferences, extension, path_buffer, len);
+}
+
+bool savestate_exists(emu_preferences *preferences, uint8_t slot)
+{
+  char path[MAX_FILENAME_LEN];
+
+  return file_exists(get_savestate_path(preferences, slot, path, sizeof(path)));
+}
+
+uint8_t save_state(struct gb_s *gb, uint8_t slot)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  char path[MAX_FILENAME_LEN];
+
+  return write_state_file(gb, get_savestate_path(preferences, slot, path, sizeof(path)));
+}
+
+void restart_broken_state(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  load_cart_ram(gb);
+  gb_set_cram(gb, preferences->cart_ram);
+  gb_reset(gb);
+}
+
+uint8_t load_state(struct gb_s *gb, uint8_t slot)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  char path[MAX_FILENAME_LEN];
+
+  const uint8_t ret = read_state_file(gb, get_savestate_path(preferences, slot, path, 
+    sizeof(path)));
+
+  if (ret == STATE_READ_BROKEN)
+  {
+    restart_broken_state(gb);
+  }
+
+  return ret;
+}
+
+uint8_t suspend_state(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  char path[MAX_FILENAME_LEN];
+
+  return write_state_file(gb, get_state_path(preferences, EXTENSION_RESUME, path, sizeof(path)));
+}
+
+uint8_t resume_state(struct gb_s *gb)
+{
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  char path[MAX_FILENAME_LEN];
+
+  get_state_path(preferences, EXTENSION_RESUME, path, sizeof(path));
+
+  if (!file_exists(path))
+  {
+    return RESUME_NONE;
+  }
+
+  const uint8_t ret = read_state_file(gb, path);
+
+  // Resume only once, the game may be saved to cart ram later on and a 
+  // stale resume file would roll that back
+  delete_file(path);
+
+  switch (ret)
+  {
+    case STATE_READ_OK:
+      return RESUME_DONE;
+
+    case STATE_READ_BROKEN:
+      return RESUME_BROKEN;
+
+    default:
+      return RESUME_NONE;
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "peanut_gb_header.h"
+#include "preferences.h"
+
+#define SAVESTATE_SLOTS   4
+
+// Increment when the file layout changes. States of a different size of 
+// struct gb_s are refused as well, as the context is stored as it is.
+#define SAVESTATE_VERSION 1
+
+// Memory is compressed in chunks of this size
+#define SAVESTATE_CHUNK_SIZE 0x4000
+
+#define STATE_READ_OK       0
+// The file could not be read or is from another rom, nothing was changed
+#define STATE_READ_REFUSED  1
+// The file broke off after memory was overwritten
+#define STATE_READ_BROKEN   2
+
+/**
+ * Gets the path of a state file of the current rom in the saves folder.
+ * 
+ * @param extension Replaces the rom extension
+ * 
+ * @return Returns path_buffer
+*/
+char *get_state_path(emu_preferences *preferences, const char *extension, char *path_buffer, 
+  size_t len);
+
+/**
+ * Writes the emulator context, WRAM, VRAM, OAM, HRAM/IO and cart RAM to a
+ * state file.
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t write_state_file(struct gb_s *gb, const char *path);
+
+/**
+ * Restores a state file written by write_state_file().
+ * 
+ * @return Returns STATE_READ_OK, STATE_READ_REFUSED or STATE_READ_BROKEN
+*/
+uint8_t read_state_file(struct gb_s *gb, const char *path);
+
+/**
+ * Starts the rom fresh with the cart ram of its save file. Used after
+ * STATE_READ_BROKEN, so the mixed memory keeps running and never gets saved.
+*/
+void restart_broken_state(struct gb_s *gb);
+
+/**
+ * Gets the path of a save state slot of the current rom.
+ * 
+ * @param slot  The slot, starting at 0
+ * 
+ * @return Returns path_buffer
+*/
+char *get_savestate_path(emu_preferences *preferences, uint8_t slot, char *path_buffer, 
+  size_t len);
+
+bool savestate_exists(emu_preferences *preferences, uint8_t slot);
+
+/**
+ * Writes the state to a save state slot.
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t save_state(struct gb_s *gb, uint8_t slot);
+
+/**
+ * Restores a save state slot. States of another rom or build are refused 
+ * before anything is changed. If the state breaks off while it is read, 
+ * the rom is restarted.
+ * 
+ * @return Returns STATE_READ_OK, STATE_READ_REFUSED or STATE_READ_BROKEN
+*/
+uint8_t load_state(struct gb_s *gb, uint8_t slot);
+
+#define RESUME_NONE   0
+#define RESUME_DONE   1
+// The resume file broke off after memory was overwritten, the rom has to 
+// be started fresh
+#define RESUME_BROKEN 2
+
+/**
+ * Writes the state to the resume file of the current rom, which is 
+ * restored the next time the rom is started.
+ * 
+ * @return Returns 0 on success else an error occured
+*/
+uint8_t suspend_state(struct gb_s *gb);
+
+/**
+ * Restores the resume file of the current rom if there is one, and
+ * deletes it.
+ * 
+ * @return Returns RESUME_NONE, RESUME_DONE or RESUME_BROKEN
+*/
+uint8_t resume_state(struct gb_s *gb);
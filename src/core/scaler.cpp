@@ -0,0 +1,88 @@
+#include "scaler.h"
+
+#include <sdk/calc/calc.hpp>
+#include "../helpers/macros.h"
+
+// Area of the panel used by the 2x mode. The area below is left for the menu
+// overlay, so the 1x mode is centered in here as well.
+#define SCALER_AREA_HEIGHT (LCD_HEIGHT * 2)
+
+scaler_table gb_scaler;
+
+void scaler_prepare(uint8_t mode)
+{
+  uint16_t y;
+  uint16_t height;
+
+  switch (mode)
+  {
+    case SCALER_1X:
+      gb_scaler.pixel_width = 1;
+      y = (SCALER_AREA_HEIGHT - LCD_HEIGHT) / 2;
+      height = LCD_HEIGHT;
+      break;
+
+    case SCALER_STRETCH:
+      // Full panel height, lines are repeated either three or four times
+      gb_scaler.pixel_width = 2;
+      y = 0;
+      height = CAS_LCD_HEIGHT;
+      break;
+
+    default:
+      mode = SCALER_2X;
+      gb_scaler.pixel_width = 2;
+      y = 0;
+      height = SCALER_AREA_HEIGHT;
+      break;
+  }
+
+  gb_scaler.mode = mode;
+  gb_scaler.width = LCD_WIDTH * gb_scaler.pixel_width;
+  gb_scaler.x = (CAS_LCD_WIDTH - gb_scaler.width) / 2;
+
+  for (uint16_t line = 0; line <= LCD_HEIGHT; line++)
+  {
+    gb_scaler.rows[line] = y + ((line * height) / LCD_HEIGHT);
+  }
+}
+
+void scaler_clear_border()
+{
+  // The menu always leaves a 2x frame behind
+  for (uint16_t row = 0; row < SCALER_AREA_HEIGHT; row++)
+  {
+    uint16_t *line = &vram[row * CAS_LCD_WIDTH];
+
+    if (row < gb_scaler.rows[0] || row >= gb_scaler.rows[LCD_HEIGHT])
+    {
+      for (uint16_t x = 0; x < CAS_LCD_WIDTH; x++)
+      {
+        line[x] = 0;
+      }
+
+      continue;
+    }
+
+    for (uint16_t x = 0; x < gb_scaler.x; x++)
+    {
+      line[x] = 0;
+      line[CAS_LCD_WIDTH - 1 - x] = 0;
+    }
+  }
+}
+
+const char *scaler_name(uint8_t mode)
+{
+  switch (mode)
+  {
+    case SCALER_1X:
+      return "1x";
+
+    case SCALER_STRETCH:
+      return "Stretch";
+
+    default:
+      return "2x";
+  }
+}
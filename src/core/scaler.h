@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include "peanut_gb_header.h"
+
+#define SCALER_1X       0
+#define SCALER_2X       1
+#define SCALER_STRETCH  2
+#define SCALER_COUNT    3
+
+// Maps gb pixels to the LCD panel. Columns are mapped by the pixel width, 
+// every gb line covers the panel rows from rows[line] to rows[line + 1] - 1.
+typedef struct
+{
+  uint16_t x;
+  uint16_t width;
+  uint8_t pixel_width;
+  uint8_t mode;
+  uint16_t rows[LCD_HEIGHT + 1];
+} scaler_table;
+
+extern scaler_table gb_scaler;
+
+void scaler_prepare(uint8_t mode);
+
+void scaler_clear_border();
+
+const char *scaler_name(uint8_t mode);
@@ -0,0 +1,133 @@
+#include "backbuffer.h"
+
+#include "../core/error.h"
+#include "../core/peanut_gb_header.h"
+#include "../emu_ui/effects.h"
+#include "../helpers/arena.h"
+#include "../helpers/functions.h"
+#include "../helpers/macros.h"
+#include <sdk/calc/calc.hpp>
+#include <stdint.h>
+#include <string.h>
+
+#define BACKBUFFER_SCREEN_SIZE                                                 \
+  (CAS_LCD_WIDTH * CAS_LCD_HEIGHT * sizeof(uint16_t))
+#define BACKBUFFER_FRAME_SIZE (LCD_WIDTH * LCD_HEIGHT * sizeof(uint16_t))
+
+typedef struct {
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+} backbuffer_rect;
+
+// The screen as it was before the lowest alert darkened it
+static uint16_t *screen = nullptr;
+static uint16_t *frame = nullptr;
+
+// Open alerts and the rectangle each of them covers
+static uint8_t depth = 0;
+static backbuffer_rect covered[BACKBUFFER_MAX_LAYERS];
+
+uint8_t backbuffer_init() {
+  if (screen) {
+    return 0;
+  }
+
+  screen = (uint16_t *)arena_alloc(&session_arena, BACKBUFFER_SCREEN_SIZE);
+  frame = (uint16_t *)arena_alloc(&session_arena, BACKBUFFER_FRAME_SIZE);
+
+  if (!screen || !frame) {
+    char err_info[ERROR_MAX_INFO_LEN];
+    char tmp[20];
+
+    screen = nullptr;
+    frame = nullptr;
+
+    strlcpy(err_info, "Backbuffer: ", sizeof(err_info));
+    strlcat(err_info,
+            itoa(BACKBUFFER_SCREEN_SIZE + BACKBUFFER_FRAME_SIZE, tmp, 10),
+            sizeof(err_info));
+    strlcat(err_info, "B", sizeof(err_info));
+
+    set_error_i(EMALLOC, err_info);
+    return 1;
+  }
+
+  return 0;
+}
+
+uint16_t *backbuffer_frame() { return frame; }
+
+void backbuffer_open() {
+  depth++;
+
+  if (!screen || depth > BACKBUFFER_MAX_LAYERS) {
+    return;
+  }
+
+  if (depth == 1) {
+    // Darken straight from the copy, the screen is only read once
+    memcpy(screen, vram, BACKBUFFER_SCREEN_SIZE);
+    darken_copy_area(screen, 0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
+  } else {
+    // The background already is dark, only the alert below is not
+    const backbuffer_rect *below = &covered[depth - 2];
+
+    darken_screen_area(below->x, below->y, below->width, below->height);
+  }
+
+  covered[depth - 1].width = 0;
+}
+
+void backbuffer_cover(uint16_t x, uint16_t y, uint16_t width,
+                      uint16_t height) {
+  if (!screen || depth == 0 || depth > BACKBUFFER_MAX_LAYERS) {
+    return;
+  }
+
+  backbuffer_rect *rect = &covered[depth - 1];
+
+  width = clamp(width, (uint16_t)0, (uint16_t)(CAS_LCD_WIDTH - x));
+  height = clamp(height, (uint16_t)0, (uint16_t)(CAS_LCD_HEIGHT - y));
+
+  if (rect->x == x && rect->y == y && rect->width == width &&
+      rect->height == height) {
+    return;
+  }
+
+  // An alert that got smaller gives back some of the dark background
+  if (rect->width != 0) {
+    darken_copy_area(screen, rect->x, rect->y, rect->width, rect->height);
+  }
+
+  rect->x = x;
+  rect->y = y;
+  rect->width = width;
+  rect->height = height;
+}
+
+void backbuffer_close() {
+  if (depth == 0) {
+    return;
+  }
+
+  depth--;
+
+  if (!screen || depth >= BACKBUFFER_MAX_LAYERS) {
+    return;
+  }
+
+  if (depth == 0) {
+    memcpy(vram, screen, BACKBUFFER_SCREEN_SIZE);
+    return;
+  }
+
+  // Only the rectangle of the alert goes back to the dark background. The
+  // alert below is drawn again by its own loop.
+  const backbuffer_rect *rect = &covered[depth];
+
+  if (rect->width != 0) {
+    darken_copy_area(screen, rect->x, rect->y, rect->width, rect->height);
+  }
+}
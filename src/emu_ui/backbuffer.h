@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Alerts opened on top of each other deeper than this are not restored
+#define BACKBUFFER_MAX_LAYERS 4
+
+/**
+ * Allocates the screen copy alerts are restored from and the buffer for
+ * the game frame behind the menu. Both are kept for the whole session.
+ *
+ * @return Returns 0 on success else an error occured
+ */
+uint8_t backbuffer_init();
+
+// The game frame is kept here while the menu is open
+uint16_t *backbuffer_frame();
+
+// Darkens the background for a new alert
+void backbuffer_open();
+
+// Tells the backbuffer which rectangle the current alert is drawn to
+void backbuffer_cover(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+// Restores what the current alert was drawn over
+void backbuffer_close();
@@ -1,21 +1,17 @@
 #include "components.h"
 
+#include "../emu_ui/backbuffer.h"
 #include "../emu_ui/colors.h"
 #include "../emu_ui/effects.h"
 #include "../emu_ui/font.h"
 #include "../emu_ui/input.h"
+#include "../core/keyboard.h"
 #include "../helpers/macros.h"
 #include <sdk/calc/calc.hpp>
 #include <sdk/os/debug.hpp>
 #include <stdint.h>
 #include <string.h>
 
-// Use namespace because of conflicting function declarations in mem.hpp and
-// string.h
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
 #define CAS_LCD_WIDTH 320
 #define CAS_LCD_HEIGHT 528
 
@@ -143,6 +139,8 @@ uint32_t draw_alert_box(const char *title, const char *subtitle, uint16_t width,
   const uint16_t x_pos = (CAS_LCD_WIDTH - width) / 2;
   const uint16_t y_pos = (CAS_LCD_HEIGHT - height) / 2;
 
+  backbuffer_cover(x_pos, y_pos, width, height);
+
   draw_rectangle(x_pos, y_pos, width, height, background, 1, border);
 
   // Print title
@@ -164,14 +162,8 @@ uint32_t draw_alert_box(const char *title, const char *subtitle, uint16_t width,
 
 void ok_alert(const char *title, const char *subtitle, const char *text,
               uint16_t foreground, uint16_t background, uint16_t border) {
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   const uint16_t text_len = strlen(text);
 
@@ -227,15 +219,12 @@ void ok_alert(const char *title, const char *subtitle, const char *text,
   wait_input_release();
 
   do {
-    getKey(&key1, &key2);
+    keyboard_read(&key1, &key2);
   } while (!testKey(key1, key2, KEY_EXE));
 
   // Wait until EXE button is released
   wait_input_release();
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 }
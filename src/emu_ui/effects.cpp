@@ -9,7 +9,23 @@
 
 #define EFFECT_DARKEN  13108 
 
+static inline uint16_t darken_pixel(uint16_t pixel)
+{
+  // calculate new rgb values through fixed point arithmetic    
+  uint8_t red = ((RGB565_TO_R(pixel) * EFFECT_DARKEN) >>16);
+  uint8_t green = ((RGB565_TO_G(pixel) * EFFECT_DARKEN) >>16);
+  uint8_t blue = ((RGB565_TO_B(pixel) * EFFECT_DARKEN) >>16);
+
+  return RGB_TO_RGB565(red, green, blue); 
+}
+
 void darken_screen_area(uint16_t x, uint16_t y, uint16_t width, uint16_t height) 
+{
+  darken_copy_area(vram, x, y, width, height);
+}
+
+void darken_copy_area(const uint16_t *src, uint16_t x, uint16_t y, uint16_t width, 
+  uint16_t height) 
 {
   uint16_t max_x = x + width;
   uint16_t max_y = y + height;
@@ -19,16 +35,7 @@ void darken_screen_area(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
   {
     for(uint16_t ix = x; ix < max_x; ix++)
     {
-      uint16_t pixel = vram[(iy * CAS_LCD_WIDTH) + ix];
-
-      // calculate new rgb values through fixed point arithmetic    
-      uint8_t red = ((RGB565_TO_R(pixel) * EFFECT_DARKEN) >>16);
-      uint8_t green = ((RGB565_TO_G(pixel) * EFFECT_DARKEN) >>16);
-      uint8_t blue = ((RGB565_TO_B(pixel) * EFFECT_DARKEN) >>16);
-    
-      pixel = RGB_TO_RGB565(red, green, blue); 
-
-      vram[(iy * CAS_LCD_WIDTH) + ix] = pixel;
+      vram[(iy * CAS_LCD_WIDTH) + ix] = darken_pixel(src[(iy * CAS_LCD_WIDTH) + ix]);
     }
   }
 }
@@ -3,3 +3,7 @@
 #include <stdint.h>
 
 void darken_screen_area(uint16_t x, uint16_t y, uint16_t width, uint16_t height); 
+
+// Writes the darkened pixels of a full screen copy to the same area on screen
+void darken_copy_area(const uint16_t *src, uint16_t x, uint16_t y, uint16_t width, 
+  uint16_t height);
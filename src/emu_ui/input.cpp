@@ -1,9 +1,9 @@
 #include "input.h"
 
 #include <stdint.h>
-#include <sdk/os/input.hpp>
 #include <sdk/calc/calc.hpp>
 #include "menu/menu.h"
+#include "../core/keyboard.h"
 
 uint32_t key_streak;  // Holds the streak amount
 uint32_t streak_key1; // Holds key1 for the current streak
@@ -28,11 +28,7 @@ void wait_input_release()
   uint32_t key1;
   uint32_t key2;
 
-  do
-  { 
-    getKey(&key1, &key2);
-  }
-  while (key1 | key2);
+  while (keyboard_read(&key1, &key2));
   
   reset_key_streak();
 }
@@ -44,15 +40,13 @@ uint8_t process_input(uint8_t **selected_h_item, uint8_t *selected_v_item,
   uint32_t key2;
 
   // Check if keys are pressed 
-  if (!Input_IsAnyKeyDown())
+  if (!keyboard_read(&key1, &key2))
   {
     reset_key_streak();
 
     return INPUT_PROC_NONE;
   }
 
-  getKey(&key1, &key2);
-
   // Check if keystreak should be increased
   if (key1 == streak_key1 && key2 == streak_key2)
   {
@@ -75,7 +69,7 @@ uint8_t process_input(uint8_t **selected_h_item, uint8_t *selected_v_item,
       LCD_Refresh(); // Refresh to create a delay
 
       // Check if key is still pressed
-      getKey(&key1, &key2);
+      keyboard_read(&key1, &key2);
 
       if (key1 != streak_key1 || key2 != streak_key2)
       {
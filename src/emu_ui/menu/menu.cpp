@@ -7,6 +7,7 @@
 #include "../../helpers/fileio.h"
 #include "../../helpers/functions.h"
 #include "../../helpers/macros.h"
+#include "../backbuffer.h"
 #include "../colors.h"
 #include "../components.h"
 #include "../effects.h"
@@ -24,12 +25,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Use namespace because of conflicting function declarations in mem.hpp and
-// string.h
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
 #define MENU_DESCRIPTION_HEIGHT 37
 #define MENU_DESCRIPTION_X_OFFSET STD_CONTENT_OFFSET
 #define MENU_TAB_HEIGHT 18
@@ -163,7 +158,8 @@ menu *prepare_load_menu_info(menu *menu) {
   menu->selected_tab = 0;
   menu->selected_item = 0;
   menu->tab_count = 1;
-  menu->tabs = (menu_tab *)hhk::malloc(sizeof(menu_tab));
+  menu->mark = arena_get_mark(&session_arena);
+  menu->tabs = (menu_tab *)arena_alloc(&session_arena, sizeof(menu_tab));
 
   if (!menu->tabs) {
     set_error(EMALLOC);
@@ -188,14 +184,16 @@ menu *prepare_menu_info(menu *menu, gb_s *gb) {
   menu->selected_tab = 0;
   menu->selected_item = 0;
   menu->tab_count = 4;
-  menu->tabs = (menu_tab *)hhk::malloc(menu->tab_count * sizeof(menu_tab));
+  menu->mark = arena_get_mark(&session_arena);
+  menu->tabs = (menu_tab *)arena_alloc(&session_arena,
+                                       menu->tab_count * sizeof(menu_tab));
 
   if (!menu->tabs) {
     set_error(EMALLOC);
     return nullptr;
   }
 
-  if (!prepare_tab_current(&(menu->tabs[0]), preferences)) {
+  if (!prepare_tab_current(&(menu->tabs[0]), gb)) {
     return nullptr;
   }
 
@@ -215,13 +213,8 @@ menu *prepare_menu_info(menu *menu, gb_s *gb) {
 }
 
 void cleanup_menu_info(menu *menu) {
-  // Free the items for each tab
-  for (uint8_t i = 0; i < menu->tab_count; i++) {
-    hhk::free(menu->tabs[i].items);
-  }
-
-  // Free the tabs array
-  hhk::free(menu->tabs);
+  // Free the tabs array and the items of each tab
+  arena_release(&session_arena, menu->mark);
 }
 
 uint8_t load_menu(emu_preferences *prefs) {
@@ -297,8 +290,7 @@ uint8_t load_menu(emu_preferences *prefs) {
 
 uint8_t emulation_menu(struct gb_s *gb, bool preview_only) {
   // Backup gb frame and display pause overlay
-  uint16_t *gb_frame_backup =
-      (uint16_t *)hhk::malloc(LCD_HEIGHT * LCD_WIDTH * sizeof(uint16_t));
+  uint16_t *gb_frame_backup = backbuffer_frame();
 
   if (gb_frame_backup) {
     for (uint16_t y = 0; y < LCD_HEIGHT; y++) {
@@ -400,8 +392,6 @@ uint8_t emulation_menu(struct gb_s *gb, bool preview_only) {
             gb_frame_backup[y * LCD_WIDTH + x];
       }
     }
-
-    hhk::free(gb_frame_backup);
   }
 
   draw_menu_overlay();
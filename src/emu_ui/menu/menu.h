@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include "../../core/emulator.h"
+#include "../../helpers/arena.h"
 #include "../../helpers/macros.h"
 
 #define MENU_CLOSED   0
@@ -23,7 +24,7 @@ typedef struct menu_item
 typedef struct
 {
   char title[10];         // The title of the menu tab
-  char description[100];  // The description of the menu tab
+  char description[128];  // The description of the menu tab
   uint8_t item_count;     // Amount of menu items
   menu_item *items;       // Array of menu items in this tab
 } menu_tab;
@@ -39,6 +40,7 @@ typedef struct
   uint8_t selected_item; // The currently selected item in the selected tab
   uint8_t tab_count;     // Amount of menu tabs
   menu_tab *tabs;        // Array of menu tabs
+  arena_mark mark;       // Tabs and items are allocated after this mark
 } menu;
 
 /*!
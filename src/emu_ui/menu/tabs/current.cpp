@@ -1,8 +1,12 @@
 #include "current.h"
 
 #include "../../../core/error.h"
+#include "../../../core/latency.h"
+#include "../../../core/rewind.h"
+#include "../../../helpers/arena.h"
 #include "../../../helpers/functions.h"
 #include "../../../helpers/macros.h"
+#include "../../backbuffer.h"
 #include "../../colors.h"
 #include "../../components.h"
 #include "../../effects.h"
@@ -12,33 +16,43 @@
 #include <stdlib.h>
 #include <string.h>
 
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
 #define TAB_CURRENT_TITLE "Current"
 
-#define TAB_CUR_ITEM_COUNT 5
+#define TAB_CUR_ITEM_COUNT 10
 
 #define TAB_CUR_ITEM_FRAMESKIP_INDEX 0
 #define TAB_CUR_ITEM_FRAMESKIP_TITLE "Frameskipping"
 #define TAB_CUR_ITEM_FRAMESKIP_SUBTITLE "Skips rendering and LCD-Refresh"
 
-#define TAB_CUR_ITEM_INTERL_INDEX 0
+#define TAB_CUR_ITEM_INTERL_INDEX 1
 #define TAB_CUR_ITEM_INTERL_TITLE "Interlacing"
 
-#define TAB_CUR_ITEM_SPEED_INDEX 1
+#define TAB_CUR_ITEM_SPEED_INDEX 2
 #define TAB_CUR_ITEM_SPEED_TITLE "Emulation Speed"
 #define TAB_CUR_ITEM_SPEED_SUBTITLE "Set the emulation speed target"
 
-#define TAB_CUR_ITEM_OVERCLOCK_INDEX 2
+#define TAB_CUR_ITEM_OVERCLOCK_INDEX 3
 #define TAB_CUR_ITEM_OVERCLOCK_TITLE "Overclock"
 
-#define TAB_CUR_ITEM_PALETTE_INDEX 3
+#define TAB_CUR_ITEM_PALETTE_INDEX 4
 #define TAB_CUR_ITEM_PALETTE_TITLE "Color Palette"
 #define TAB_CUR_ITEM_PALETTE_SUBTITLE "Select a palette for this ROM"
 
-#define TAB_CUR_ITEM_QUIT_INDEX 4
+#define TAB_CUR_ITEM_SCALER_INDEX 5
+#define TAB_CUR_ITEM_SCALER_TITLE "Scaling"
+
+#define TAB_CUR_ITEM_INPUT_INDEX 6
+#define TAB_CUR_ITEM_INPUT_TITLE "Input Polling"
+
+#define TAB_CUR_ITEM_LATENCY_INDEX 7
+#define TAB_CUR_ITEM_LATENCY_TITLE "Input Latency"
+#define TAB_CUR_ITEM_LATENCY_SUBTITLE "Percentiles p50 / p90 / p99 in ms"
+
+#define TAB_CUR_ITEM_REWIND_INDEX 8
+#define TAB_CUR_ITEM_REWIND_TITLE "Rewind"
+#define TAB_CUR_ITEM_REWIND_SUBTITLE "Hold [<--] to rewind"
+
+#define TAB_CUR_ITEM_QUIT_INDEX 9
 #define TAB_CUR_ITEM_QUIT_TITLE "Quit CPBoy"
 
 #define DIALOG_FRAMESKIP_ITEM_COUNT 3
@@ -49,6 +63,10 @@ namespace hhk {
 
 #define DIALOG_PALETTE_WIDTH 200
 
+#define DIALOG_REWIND_ITEM_COUNT 4
+#define DIALOG_REWIND_STATS_LINES 3
+#define DIALOG_REWIND_WIDTH 240
+
 #define DIALOG_SPEED_ITEM_COUNT 2
 #define DIALOG_SPEED_WIDTH 200
 
@@ -57,6 +75,34 @@ namespace hhk {
   "This will increase performance at the cost of decreased battery life.\n\n"  \
   "Use at your own risk"
 
+const char *frameskip_mode_name(emu_preferences *preferences) {
+  if (!preferences->config.frameskip_enabled) {
+    return "Disabled";
+  }
+
+  return (preferences->config.frameskip_auto) ? "Auto" : "Enabled";
+}
+
+void update_frameskip_item(menu_item *item, emu_preferences *preferences) {
+  strlcpy(item->value, frameskip_mode_name(preferences), sizeof(item->value));
+  item->value_color =
+      (preferences->config.frameskip_enabled) ? COLOR_SUCCESS : COLOR_DANGER;
+
+  // Append number of frames currently skipped when enabled
+  if (preferences->config.frameskip_enabled) {
+    char tmp[4];
+
+    strlcat(item->value, " (", sizeof(item->value));
+    strlcat(item->value,
+            itoa((preferences->config.frameskip_auto)
+                     ? preferences->config.frameskip_auto_amount
+                     : preferences->config.frameskip_amount,
+                 tmp, 10),
+            sizeof(item->value));
+    strlcat(item->value, ")", sizeof(item->value));
+  }
+}
+
 void draw_frameskip_alert(emu_preferences *preferences, uint8_t selected_item) {
   uint32_t position =
       draw_alert_box(TAB_CUR_ITEM_FRAMESKIP_TITLE,
@@ -73,10 +119,9 @@ void draw_frameskip_alert(emu_preferences *preferences, uint8_t selected_item) {
   const uint16_t slider_width = DIALOG_FRAMESKIP_WIDTH - slider_offset -
                                 (4 * DEBUG_CHAR_WIDTH) - STD_CONTENT_OFFSET;
 
-  // Draw frameskip enabled state
+  // Draw frameskip mode, in auto mode the amount is the upper bound
   print_string_centered(
-      (preferences->config.frameskip_enabled) ? "Enabled" : "Disabled",
-      dialog_x, dialog_y + ALERT_CONTENT_OFFSET_Y, DIALOG_FRAMESKIP_WIDTH, 0,
+      frameskip_mode_name(preferences), dialog_x, dialog_y + ALERT_CONTENT_OFFSET_Y, DIALOG_FRAMESKIP_WIDTH, 0,
       (preferences->config.frameskip_enabled) ? COLOR_SUCCESS : COLOR_DANGER,
       (selected_item == 0) ? COLOR_SELECTED : COLOR_BLACK, true);
 
@@ -110,6 +155,160 @@ void draw_frameskip_alert(emu_preferences *preferences, uint8_t selected_item) {
       (selected_item == 2) ? COLOR_SELECTED : COLOR_BLACK, true);
 }
 
+void update_rewind_item(menu_item *item, emu_preferences *preferences) {
+  char tmp[4];
+
+  item->value_color = (rewind_enabled()) ? COLOR_SUCCESS : COLOR_DANGER;
+
+  if (!preferences->config.rewind_enabled) {
+    strlcpy(item->value, "Disabled", sizeof(item->value));
+    return;
+  }
+
+  if (!rewind_enabled()) {
+    strlcpy(item->value, "No Memory", sizeof(item->value));
+    return;
+  }
+
+  // Show the snapshot interval
+  strlcpy(item->value, "Every ", sizeof(item->value));
+  strlcat(item->value, itoa(preferences->config.rewind_interval, tmp, 10),
+          sizeof(item->value));
+  strlcat(item->value, " fr", sizeof(item->value));
+}
+
+void append_tenths(char *text, uint16_t len, uint32_t value) {
+  char tmp[11];
+
+  strlcat(text, itoa(value / 10, tmp, 10), len);
+  strlcat(text, ".", len);
+  strlcat(text, itoa(value % 10, tmp, 10), len);
+}
+
+// Fills the lines about the rewind cost shown below the settings
+void get_rewind_stats_text(emu_preferences *preferences,
+                           char (*lines)[60]) {
+  rewind_stats stats;
+  char tmp[11];
+
+  rewind_get_stats(&stats);
+
+  for (uint8_t i = 0; i < DIALOG_REWIND_STATS_LINES; i++) {
+    lines[i][0] = '\0';
+  }
+
+  if (!rewind_enabled()) {
+    if (preferences->config.rewind_enabled) {
+      strlcpy(lines[0], "Not enough memory", sizeof(lines[0]));
+    }
+
+    return;
+  }
+
+  strlcpy(lines[0], "History: ", sizeof(lines[0]));
+  append_tenths(lines[0], sizeof(lines[0]), (stats.frames * 10) / 60);
+  strlcat(lines[0], "s (", sizeof(lines[0]));
+  strlcat(lines[0], itoa(stats.snapshots, tmp, 10), sizeof(lines[0]));
+  strlcat(lines[0], " snapshots)", sizeof(lines[0]));
+
+  strlcpy(lines[1], "Memory: ", sizeof(lines[1]));
+  strlcat(lines[1], itoa(stats.memory / 1024, tmp, 10), sizeof(lines[1]));
+  strlcat(lines[1], "K (", sizeof(lines[1]));
+  strlcat(lines[1], itoa(stats.ring_used / 1024, tmp, 10), sizeof(lines[1]));
+  strlcat(lines[1], "K used)", sizeof(lines[1]));
+
+  strlcpy(lines[2], "Snapshot: ", sizeof(lines[2]));
+  append_tenths(lines[2], sizeof(lines[2]), stats.snapshot_avg);
+  strlcat(lines[2], "ms, max ", sizeof(lines[2]));
+  append_tenths(lines[2], sizeof(lines[2]), stats.snapshot_max);
+  strlcat(lines[2], "ms", sizeof(lines[2]));
+}
+
+void draw_rewind_alert(emu_preferences *preferences, uint8_t selected_item) {
+  const uint16_t dialog_height =
+      ALERT_CONTENT_OFFSET_Y +
+      ((3 + DIALOG_REWIND_STATS_LINES + 1) * DEBUG_LINE_HEIGHT) +
+      (5 * STD_CONTENT_OFFSET);
+
+  uint32_t position = draw_alert_box(
+      TAB_CUR_ITEM_REWIND_TITLE, TAB_CUR_ITEM_REWIND_SUBTITLE,
+      DIALOG_REWIND_WIDTH, dialog_height, COLOR_MENU_BG, COLOR_PRIMARY);
+
+  char tmp[8];
+  char lines[DIALOG_REWIND_STATS_LINES][60];
+
+  const uint16_t dialog_x = ALERT_GET_X(position);
+  const uint16_t dialog_y = ALERT_GET_Y(position);
+
+  const uint16_t slider_offset =
+      ALERT_CONTENT_OFFSET_X + (7 * DEBUG_CHAR_WIDTH);
+  const uint16_t slider_width = DIALOG_REWIND_WIDTH - slider_offset -
+                                (6 * DEBUG_CHAR_WIDTH) - STD_CONTENT_OFFSET;
+  const uint16_t value_x = dialog_x + slider_offset + slider_width +
+                           STD_CONTENT_OFFSET + STD_CONTENT_OFFSET;
+
+  uint16_t y = dialog_y + ALERT_CONTENT_OFFSET_Y;
+
+  // Draw rewind state
+  print_string_centered(
+      (preferences->config.rewind_enabled) ? "Enabled" : "Disabled", dialog_x,
+      y, DIALOG_REWIND_WIDTH, 0,
+      (preferences->config.rewind_enabled) ? COLOR_SUCCESS : COLOR_DANGER,
+      (selected_item == 0) ? COLOR_SELECTED : COLOR_BLACK, true);
+
+  // Draw interval slider
+  y += DEBUG_LINE_HEIGHT + STD_CONTENT_OFFSET;
+
+  print_string("Every", dialog_x + ALERT_CONTENT_OFFSET_X, y, 0, COLOR_WHITE,
+               COLOR_BLACK, true);
+
+  draw_slider(dialog_x + slider_offset, y, slider_width, SLIDER_STD_TRACK_COLOR,
+              (selected_item == 1) ? COLOR_PRIMARY : COLOR_WHITE,
+              REWIND_INTERVAL_MIN, REWIND_INTERVAL_MAX,
+              preferences->config.rewind_interval);
+
+  itoa(preferences->config.rewind_interval, tmp, 10);
+  strlcat(tmp, "fr", sizeof(tmp));
+
+  print_string_centered(tmp, value_x, y, (DEBUG_CHAR_WIDTH - 2) * 6, 0,
+                        COLOR_WHITE, COLOR_BLACK, true);
+
+  // Draw buffer size slider
+  y += DEBUG_LINE_HEIGHT + STD_CONTENT_OFFSET;
+
+  print_string("Buffer", dialog_x + ALERT_CONTENT_OFFSET_X, y, 0, COLOR_WHITE,
+               COLOR_BLACK, true);
+
+  draw_slider(dialog_x + slider_offset, y, slider_width, SLIDER_STD_TRACK_COLOR,
+              (selected_item == 2) ? COLOR_PRIMARY : COLOR_WHITE,
+              REWIND_BUFFER_MIN, REWIND_BUFFER_MAX,
+              preferences->config.rewind_buffer);
+
+  itoa((preferences->config.rewind_buffer * REWIND_BUFFER_STEP) / 1024, tmp, 10);
+  strlcat(tmp, "K", sizeof(tmp));
+
+  print_string_centered(tmp, value_x, y, (DEBUG_CHAR_WIDTH - 2) * 6, 0,
+                        COLOR_WHITE, COLOR_BLACK, true);
+
+  // Draw what rewinding currently costs
+  get_rewind_stats_text(preferences, lines);
+  y += DEBUG_LINE_HEIGHT + STD_CONTENT_OFFSET;
+
+  for (uint8_t i = 0; i < DIALOG_REWIND_STATS_LINES; i++) {
+    print_string(lines[i], dialog_x + ALERT_CONTENT_OFFSET_X,
+                 y + (i * DEBUG_LINE_HEIGHT), 0, COLOR_DISABLED, COLOR_BLACK,
+                 true);
+  }
+
+  // Print ok button
+  y += (DIALOG_REWIND_STATS_LINES * DEBUG_LINE_HEIGHT) + STD_CONTENT_OFFSET;
+
+  print_string_centered(
+      "OK", dialog_x + ALERT_CONTENT_OFFSET_X, y,
+      DIALOG_REWIND_WIDTH - (2 * ALERT_CONTENT_OFFSET_X), 0, COLOR_WHITE,
+      (selected_item == 3) ? COLOR_SELECTED : COLOR_BLACK, true);
+}
+
 void draw_speed_alert(emu_preferences *preferences, uint8_t selected_item) {
   uint16_t dialog_height = ALERT_CONTENT_OFFSET_Y + (2 * DEBUG_LINE_HEIGHT) +
                            (3 * STD_CONTENT_OFFSET);
@@ -188,16 +387,11 @@ void draw_palette_selection_alert(emu_preferences *preferences,
 int32_t frameskip_alert(struct gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   bool frameskip_enabled = preferences->config.frameskip_enabled;
+  bool frameskip_auto = preferences->config.frameskip_auto;
   uint8_t frameskip_amount;
 
   uint8_t selected_item = 0;
@@ -221,7 +415,16 @@ int32_t frameskip_alert(struct gb_s *gb) {
                       DIALOG_FRAMESKIP_ITEM_COUNT, nullptr,
                       false) == INPUT_PROC_EXECUTE) {
       if (selected_item == 0) {
-        TOGGLE(frameskip_enabled);
+        // Cycle through disabled, enabled and auto
+        if (!frameskip_enabled) {
+          frameskip_enabled = true;
+          frameskip_auto = false;
+        } else if (!frameskip_auto) {
+          frameskip_auto = true;
+        } else {
+          frameskip_enabled = false;
+          frameskip_auto = false;
+        }
       } else if (selected_item == 2) {
         break;
       }
@@ -229,31 +432,75 @@ int32_t frameskip_alert(struct gb_s *gb) {
 
     // Apply frameskip to emulator
     set_frameskip(gb, frameskip_enabled, frameskip_amount + FRAMESKIP_MIN);
+    set_frameskip_auto(gb, frameskip_auto);
 
     LCD_Refresh();
   }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
 
-int32_t emu_speed_alert(struct gb_s *gb) {
+int32_t rewind_alert(struct gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
+
+  bool rewind_on = preferences->config.rewind_enabled;
+  uint8_t interval;
+  uint8_t buffer;
 
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
+  uint8_t selected_item = 0;
+
+  // Create horizontal items count
+  static const uint8_t h_items_count[DIALOG_REWIND_ITEM_COUNT] = {
+      1, REWIND_INTERVAL_MAX - REWIND_INTERVAL_MIN + 1,
+      REWIND_BUFFER_MAX - REWIND_BUFFER_MIN + 1, 1};
+
+  // Create horizontal items pointer
+  uint8_t *selected_h_items[DIALOG_REWIND_ITEM_COUNT] = {nullptr, &interval,
+                                                         &buffer, nullptr};
+
+  // Rendering and input handling
+  for (;;) {
+    interval = preferences->config.rewind_interval - REWIND_INTERVAL_MIN;
+    buffer = preferences->config.rewind_buffer - REWIND_BUFFER_MIN;
+
+    draw_rewind_alert(preferences, selected_item);
+
+    // Check if OK button or toggle was pressed
+    if (process_input(selected_h_items, &selected_item, h_items_count,
+                      DIALOG_REWIND_ITEM_COUNT, nullptr,
+                      false) == INPUT_PROC_EXECUTE) {
+      if (selected_item == 0) {
+        rewind_on = !rewind_on;
+      } else if (selected_item == 3) {
+        break;
+      }
+    }
+
+    // Apply rewind settings, a new buffer size starts an empty history
+    set_rewind(gb, rewind_on, interval + REWIND_INTERVAL_MIN,
+               buffer + REWIND_BUFFER_MIN);
+
+    LCD_Refresh();
   }
 
+  // Close alert
+  backbuffer_close();
+
+  return 0;
+}
+
+int32_t emu_speed_alert(struct gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
+
   uint8_t emu_speed;
   uint8_t selected_item = 0;
 
@@ -287,10 +534,7 @@ int32_t emu_speed_alert(struct gb_s *gb) {
   }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
@@ -298,14 +542,8 @@ int32_t emu_speed_alert(struct gb_s *gb) {
 int32_t palette_selection_alert(struct gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   uint8_t selected_item = 0;
 
@@ -338,6 +576,7 @@ int32_t palette_selection_alert(struct gb_s *gb) {
 
       preferences->file_states.rom_config_changed = true;
       preferences->config.selected_palette = selected_item;
+      gb_update_palette_lut(gb);
       break;
     }
 
@@ -345,10 +584,7 @@ int32_t palette_selection_alert(struct gb_s *gb) {
   }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
@@ -358,20 +594,7 @@ int32_t action_frameskip_selection(menu_item *item, gb_s *gb) {
   int32_t return_code = frameskip_alert(gb);
 
   // Update item value text and color
-  strlcpy(item->value,
-          (preferences->config.frameskip_enabled) ? "Enabled (" : "Disabled",
-          sizeof(item->value));
-  item->value_color =
-      (preferences->config.frameskip_enabled) ? COLOR_SUCCESS : COLOR_DANGER;
-
-  // Append number of frames to skip when enabled
-  if (preferences->config.frameskip_enabled) {
-    char tmp[4];
-
-    strlcat(item->value, itoa(preferences->config.frameskip_amount, tmp, 10),
-            sizeof(item->value));
-    strlcat(item->value, ")", sizeof(item->value));
-  }
+  update_frameskip_item(item, preferences);
 
   return return_code;
 }
@@ -393,6 +616,16 @@ int32_t action_speed_selection(menu_item *item, gb_s *gb) {
   return return_code;
 }
 
+int32_t action_rewind_selection(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  int32_t return_code = rewind_alert(gb);
+
+  // Update item value text and color
+  update_rewind_item(item, preferences);
+
+  return return_code;
+}
+
 int32_t action_interlacing_selection(menu_item *item, gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
@@ -409,6 +642,97 @@ int32_t action_interlacing_selection(menu_item *item, gb_s *gb) {
   return 0;
 }
 
+int32_t action_scaler_selection(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  // Cycle through scalers
+  set_scaler(gb, (preferences->config.scaler + 1) % SCALER_COUNT);
+
+  // Update item value text
+  strlcpy(item->value, scaler_name(preferences->config.scaler),
+          sizeof(item->value));
+
+  return 0;
+}
+
+int32_t action_input_selection(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  // Toggle between polling once per frame and on JOYP reads
+  set_lazy_input(gb, !preferences->config.lazy_input);
+
+  // Update item value text
+  strlcpy(item->value, (preferences->config.lazy_input) ? "On Read" : "Per Frame",
+          sizeof(item->value));
+
+  return 0;
+}
+
+void update_latency_item(menu_item *item) {
+  strlcpy(item->value, (latency_enabled()) ? "Measuring (" : "Disabled",
+          sizeof(item->value));
+  item->value_color = (latency_enabled()) ? COLOR_SUCCESS : COLOR_DANGER;
+
+  // Append number of key presses measured so far
+  if (latency_enabled()) {
+    latency_stats stats;
+    char tmp[4];
+
+    latency_get_stats(LATENCY_LCD, &stats);
+    strlcat(item->value, itoa(stats.count, tmp, 10), sizeof(item->value));
+    strlcat(item->value, ")", sizeof(item->value));
+  }
+}
+
+void append_latency_stats(char *text, uint16_t len, const char *label,
+                          uint8_t series) {
+  latency_stats stats;
+  char tmp[8];
+
+  latency_get_stats(series, &stats);
+
+  const uint16_t values[3] = {stats.p50, stats.p90, stats.p99};
+
+  strlcat(text, label, len);
+
+  for (uint8_t i = 0; i < 3; i++) {
+    strlcat(text, (i == 0) ? " " : " / ", len);
+    strlcat(text, itoa(values[i] / 10, tmp, 10), len);
+    strlcat(text, ".", len);
+    strlcat(text, itoa(values[i] % 10, tmp, 10), len);
+  }
+
+  strlcat(text, "\n", len);
+}
+
+int32_t action_latency_selection(menu_item *item, gb_s *gb) {
+  if (!latency_enabled()) {
+    latency_enable(gb, true);
+    update_latency_item(item);
+    return 0;
+  }
+
+  // Show the results, then stop measuring
+  latency_stats stats;
+  char text[120] = "";
+  char tmp[4];
+
+  latency_get_stats(LATENCY_JOYP, &stats);
+
+  append_latency_stats(text, sizeof(text), "Key to JOYP:", LATENCY_JOYP);
+  append_latency_stats(text, sizeof(text), "Key to LCD:", LATENCY_LCD);
+  strlcat(text, "Key presses: ", sizeof(text));
+  strlcat(text, itoa(stats.count, tmp, 10), sizeof(text));
+
+  ok_alert(TAB_CUR_ITEM_LATENCY_TITLE, TAB_CUR_ITEM_LATENCY_SUBTITLE, text,
+           COLOR_WHITE, COLOR_MENU_BG, COLOR_PRIMARY);
+
+  latency_enable(gb, false);
+  update_latency_item(item);
+
+  return 0;
+}
+
 int32_t action_overclock_selection(menu_item *item, gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
@@ -448,14 +772,23 @@ int32_t action_quit_emulator(menu_item *item, gb_s *gb) {
   return MENU_EMU_QUIT;
 }
 
-menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences) {
+menu_tab *prepare_tab_current(menu_tab *tab, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
   char filename[TAB_DESCR_MAX_FILENAME_LENGTH + 1];
+  char tmp[8];
 
   // Description and title for "Settings" tab
   strlcpy(tab->title, TAB_CURRENT_TITLE, sizeof(tab->title));
   strlcpy(tab->description, "Current ROM: ", sizeof(tab->description));
   strlcat(tab->description, preferences->current_rom_name,
           sizeof(tab->description));
+
+  // Background pixels the window covered in the last frame, so they were
+  // not rendered
+  strlcat(tab->description, "  BG skip: ", sizeof(tab->description));
+  strlcat(tab->description, itoa(gb->display.bg_pixels_skipped_last, tmp, 10),
+          sizeof(tab->description));
+  strlcat(tab->description, "px", sizeof(tab->description));
   strlcat(tab->description, "\nFilename: ", sizeof(tab->description));
 
   // If filename is too long, copy only first TAB_DESCR_MAX_FILENAME_LENGTH
@@ -471,8 +804,8 @@ menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences) {
   strlcat(tab->description, filename, sizeof(tab->description));
 
   tab->item_count = TAB_CUR_ITEM_COUNT;
-  tab->items =
-      (menu_item *)hhk::malloc(TAB_CUR_ITEM_COUNT * sizeof(menu_item));
+  tab->items = (menu_item *)arena_alloc(
+      &session_arena, TAB_CUR_ITEM_COUNT * sizeof(menu_item));
 
   if (!tab->items) {
     set_error(EMALLOC);
@@ -483,8 +816,12 @@ menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences) {
   tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].disabled = false;
   tab->items[TAB_CUR_ITEM_SPEED_INDEX].disabled = false;
   tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].disabled = false;
-  // tab->items[TAB_CUR_ITEM_INTERL_INDEX].disabled = false;
+  tab->items[TAB_CUR_ITEM_INTERL_INDEX].disabled = false;
   tab->items[TAB_CUR_ITEM_PALETTE_INDEX].disabled = false;
+  tab->items[TAB_CUR_ITEM_SCALER_INDEX].disabled = false;
+  tab->items[TAB_CUR_ITEM_INPUT_INDEX].disabled = false;
+  tab->items[TAB_CUR_ITEM_LATENCY_INDEX].disabled = false;
+  tab->items[TAB_CUR_ITEM_REWIND_INDEX].disabled = false;
   tab->items[TAB_CUR_ITEM_QUIT_INDEX].disabled = false;
 
   // Title for each item
@@ -496,29 +833,29 @@ menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences) {
   strlcpy(tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].title,
           TAB_CUR_ITEM_OVERCLOCK_TITLE,
           sizeof(tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].title));
-  // strlcpy(tab->items[TAB_CUR_ITEM_INTERL_INDEX].title,
-  // TAB_CUR_ITEM_INTERL_TITLE,
-  // sizeof(tab->items[TAB_CUR_ITEM_INTERL_INDEX].title));
+  strlcpy(tab->items[TAB_CUR_ITEM_INTERL_INDEX].title,
+          TAB_CUR_ITEM_INTERL_TITLE,
+          sizeof(tab->items[TAB_CUR_ITEM_INTERL_INDEX].title));
   strlcpy(tab->items[TAB_CUR_ITEM_PALETTE_INDEX].title,
           TAB_CUR_ITEM_PALETTE_TITLE,
           sizeof(tab->items[TAB_CUR_ITEM_PALETTE_INDEX].title));
+  strlcpy(tab->items[TAB_CUR_ITEM_SCALER_INDEX].title,
+          TAB_CUR_ITEM_SCALER_TITLE,
+          sizeof(tab->items[TAB_CUR_ITEM_SCALER_INDEX].title));
+  strlcpy(tab->items[TAB_CUR_ITEM_INPUT_INDEX].title,
+          TAB_CUR_ITEM_INPUT_TITLE,
+          sizeof(tab->items[TAB_CUR_ITEM_INPUT_INDEX].title));
+  strlcpy(tab->items[TAB_CUR_ITEM_LATENCY_INDEX].title,
+          TAB_CUR_ITEM_LATENCY_TITLE,
+          sizeof(tab->items[TAB_CUR_ITEM_LATENCY_INDEX].title));
+  strlcpy(tab->items[TAB_CUR_ITEM_REWIND_INDEX].title,
+          TAB_CUR_ITEM_REWIND_TITLE,
+          sizeof(tab->items[TAB_CUR_ITEM_REWIND_INDEX].title));
   strlcpy(tab->items[TAB_CUR_ITEM_QUIT_INDEX].title, TAB_CUR_ITEM_QUIT_TITLE,
           sizeof(tab->items[TAB_CUR_ITEM_QUIT_INDEX].title));
 
   // Value for each item
-  strlcpy(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value,
-          (preferences->config.frameskip_enabled) ? "Enabled (" : "Disabled",
-          sizeof(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value));
-
-  if (preferences->config.frameskip_enabled) {
-    char tmp[4];
-
-    itoa(preferences->config.frameskip_amount, tmp, 10);
-    strlcat(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value, tmp,
-            sizeof(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value));
-    strlcat(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value, ")",
-            sizeof(tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value));
-  }
+  update_frameskip_item(&tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX], preferences);
 
   if (preferences->config.emulation_speed == EMU_SPEED_MAX + EMU_SPEED_STEP) {
     strlcpy(tab->items[TAB_CUR_ITEM_SPEED_INDEX].value, "Unlocked",
@@ -530,34 +867,45 @@ menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences) {
             sizeof(tab->items[TAB_CUR_ITEM_SPEED_INDEX].value));
   }
 
-  // strlcpy(tab->items[TAB_CUR_ITEM_INTERL_INDEX].value,
-  //   (preferences->config.interlacing_enabled)? "Enabled" : "Disabled",
-  //   sizeof(tab->items[TAB_CUR_ITEM_INTERL_INDEX].value));
+  strlcpy(tab->items[TAB_CUR_ITEM_INTERL_INDEX].value,
+          (preferences->config.interlacing_enabled) ? "Enabled" : "Disabled",
+          sizeof(tab->items[TAB_CUR_ITEM_INTERL_INDEX].value));
   strlcpy(tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].value,
           (preferences->config.overclock_enabled) ? "Enabled" : "Disabled",
           sizeof(tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].value));
   strlcpy(tab->items[TAB_CUR_ITEM_PALETTE_INDEX].value,
           preferences->palettes[preferences->config.selected_palette].name,
           sizeof(tab->items[TAB_CUR_ITEM_PALETTE_INDEX].value));
+  strlcpy(tab->items[TAB_CUR_ITEM_SCALER_INDEX].value,
+          scaler_name(preferences->config.scaler),
+          sizeof(tab->items[TAB_CUR_ITEM_SCALER_INDEX].value));
+  strlcpy(tab->items[TAB_CUR_ITEM_INPUT_INDEX].value,
+          (preferences->config.lazy_input) ? "On Read" : "Per Frame",
+          sizeof(tab->items[TAB_CUR_ITEM_INPUT_INDEX].value));
+  update_latency_item(&tab->items[TAB_CUR_ITEM_LATENCY_INDEX]);
+  update_rewind_item(&tab->items[TAB_CUR_ITEM_REWIND_INDEX], preferences);
   tab->items[TAB_CUR_ITEM_QUIT_INDEX].value[0] = '\0';
 
   // Value color for each item
-  tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].value_color =
-      (preferences->config.frameskip_enabled) ? COLOR_SUCCESS : COLOR_DANGER;
-  // tab->items[TAB_CUR_ITEM_INTERL_INDEX].value_color =
-  //   (preferences->config.interlacing_enabled)? COLOR_SUCCESS : COLOR_DANGER;
+  tab->items[TAB_CUR_ITEM_INTERL_INDEX].value_color =
+      (preferences->config.interlacing_enabled) ? COLOR_SUCCESS : COLOR_DANGER;
   tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].value_color =
       (preferences->config.overclock_enabled) ? COLOR_SUCCESS : COLOR_DANGER;
   tab->items[TAB_CUR_ITEM_SPEED_INDEX].value_color = COLOR_SUCCESS;
   tab->items[TAB_CUR_ITEM_PALETTE_INDEX].value_color = COLOR_SUCCESS;
+  tab->items[TAB_CUR_ITEM_SCALER_INDEX].value_color = COLOR_SUCCESS;
+  tab->items[TAB_CUR_ITEM_INPUT_INDEX].value_color = COLOR_SUCCESS;
 
   // Action for each item
   tab->items[TAB_CUR_ITEM_FRAMESKIP_INDEX].action = action_frameskip_selection;
   tab->items[TAB_CUR_ITEM_SPEED_INDEX].action = action_speed_selection;
-  // tab->items[TAB_CUR_ITEM_INTERL_INDEX].action =
-  // action_interlacing_selection;
+  tab->items[TAB_CUR_ITEM_INTERL_INDEX].action = action_interlacing_selection;
   tab->items[TAB_CUR_ITEM_OVERCLOCK_INDEX].action = action_overclock_selection;
   tab->items[TAB_CUR_ITEM_PALETTE_INDEX].action = action_palette_selection;
+  tab->items[TAB_CUR_ITEM_SCALER_INDEX].action = action_scaler_selection;
+  tab->items[TAB_CUR_ITEM_INPUT_INDEX].action = action_input_selection;
+  tab->items[TAB_CUR_ITEM_LATENCY_INDEX].action = action_latency_selection;
+  tab->items[TAB_CUR_ITEM_REWIND_INDEX].action = action_rewind_selection;
   tab->items[TAB_CUR_ITEM_QUIT_INDEX].action = action_quit_emulator;
 
   return tab;
@@ -3,4 +3,4 @@
 #include "../menu.h"
 #include "../../../core/preferences.h"
 
-menu_tab *prepare_tab_current(menu_tab *tab, emu_preferences *preferences);
+menu_tab *prepare_tab_current(menu_tab *tab, gb_s *gb);
@@ -1,6 +1,7 @@
 #include "load.h"
 
 #include "../../../core/error.h"
+#include "../../../helpers/arena.h"
 #include "../../../helpers/fileio.h"
 #include "../../../helpers/functions.h"
 #include "../../../helpers/macros.h"
@@ -15,10 +16,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
 #define TAB_LOAD_TITLE "Load"
 #define TAB_LOAD_ITEM_COUNT 20
 
@@ -38,8 +35,11 @@ menu_tab *prepare_tab_load(menu_tab *tab) {
 
   tab->item_count =
       find_files(DIRECTORY_ROM "\\*" EXTENSION_ROM, files, TAB_LOAD_ITEM_COUNT);
-  tab->items =
-      (menu_item *)hhk::malloc(tab->item_count * sizeof(menu_item));
+  tab->item_count +=
+      find_files(DIRECTORY_ROM "\\*" EXTENSION_ROM_PACKED,
+                 files + tab->item_count, TAB_LOAD_ITEM_COUNT - tab->item_count);
+  tab->items = (menu_item *)arena_alloc(
+      &session_arena, tab->item_count * sizeof(menu_item));
 
   if (!(tab->items)) {
     set_error(EMALLOC);
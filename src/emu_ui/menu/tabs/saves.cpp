@@ -1,6 +1,10 @@
 #include "saves.h"
 
 #include "../../../core/error.h"
+#include "../../../core/movie.h"
+#include "../../../core/savestate.h"
+#include "../../../helpers/arena.h"
+#include "../../../helpers/functions.h"
 #include "../../../helpers/macros.h"
 #include "../../colors.h"
 #include "../../components.h"
@@ -12,31 +16,233 @@
 #include <stdlib.h>
 #include <string.h>
 
-namespace hhk {
-#include <sdk/os/mem.hpp>
+#define TAB_SAVES_TITLE "Saves"
+#define TAB_SAVES_ITEM_COUNT (2 * SAVESTATE_SLOTS + 3)
+
+#define TAB_SAVES_ITEM_SAVE_TITLE "Save State "
+#define TAB_SAVES_ITEM_LOAD_TITLE "Load State "
+
+#define TAB_SAVES_ITEM_RECORD       (2 * SAVESTATE_SLOTS)
+#define TAB_SAVES_ITEM_RECORD_RESET (2 * SAVESTATE_SLOTS + 1)
+#define TAB_SAVES_ITEM_REPLAY       (2 * SAVESTATE_SLOTS + 2)
+
+// Save items come first, followed by the load items of the same slots and
+// the movie items
+static menu_item *saves_items = nullptr;
+
+void update_slot_items(emu_preferences *preferences, uint8_t slot) {
+  menu_item *save_item = &saves_items[slot];
+  menu_item *load_item = &saves_items[SAVESTATE_SLOTS + slot];
+  const bool used = savestate_exists(preferences, slot);
+
+  strlcpy(save_item->value, (used) ? "Used" : "Empty",
+          sizeof(save_item->value));
+  save_item->value_color = (used) ? COLOR_WHITE : COLOR_DISABLED;
+
+  load_item->disabled = !used;
 }
 
-#define TAB_SAVES_TITLE "Saves"
+void update_movie_items(emu_preferences *preferences) {
+  menu_item *record_item = &saves_items[TAB_SAVES_ITEM_RECORD];
+  menu_item *reset_item = &saves_items[TAB_SAVES_ITEM_RECORD_RESET];
+  menu_item *replay_item = &saves_items[TAB_SAVES_ITEM_REPLAY];
+  movie_info info;
+  char tmp[12];
+
+  movie_get_info(&info);
+
+  record_item->value[0] = '\0';
+  record_item->value_color = COLOR_WHITE;
+  reset_item->disabled = (info.state == MOVIE_RECORDING);
+  replay_item->disabled = !movie_exists(preferences);
+  replay_item->value[0] = '\0';
+  replay_item->value_color = COLOR_WHITE;
+
+  switch (info.state) {
+  case MOVIE_RECORDING:
+    // Selecting it again stops the recording
+    itoa(info.frames, tmp, 10);
+    strlcpy(record_item->value, "Stop at ", sizeof(record_item->value));
+    strlcat(record_item->value, tmp, sizeof(record_item->value));
+    record_item->value_color = COLOR_DANGER;
+    return;
+
+  case MOVIE_REPLAYING:
+    itoa(info.frames, tmp, 10);
+    strlcpy(replay_item->value, tmp, sizeof(replay_item->value));
+    itoa(info.total_frames, tmp, 10);
+    strlcat(replay_item->value, "/", sizeof(replay_item->value));
+    strlcat(replay_item->value, tmp, sizeof(replay_item->value));
+    break;
+
+  case MOVIE_REPLAY_DONE:
+    strlcpy(replay_item->value, "Done", sizeof(replay_item->value));
+    replay_item->value_color = COLOR_SUCCESS;
+    break;
+
+  default:
+    return;
+  }
+
+  // Replays that went another way than the recording
+  if (info.mismatches > 0) {
+    itoa(info.first_mismatch, tmp, 10);
+    strlcat(replay_item->value, ", desync at ", sizeof(replay_item->value));
+    strlcat(replay_item->value, tmp, sizeof(replay_item->value));
+    replay_item->value_color = COLOR_DANGER;
+  }
+}
+
+void savestate_error_alert(const char *title) {
+  char text[ERROR_MAX_INFO_LEN + 60];
+
+  strlcpy(text, get_error_string(errno), sizeof(text));
+  strlcat(text, "\n", sizeof(text));
+  strlcat(text, error_info, sizeof(text));
+
+  ok_alert(title, nullptr, text, COLOR_DANGER, COLOR_BLACK, COLOR_DANGER);
+}
+
+int32_t action_save_state(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  const uint8_t slot = item - saves_items;
+
+  if (save_state(gb, slot)) {
+    savestate_error_alert("Saving state failed");
+  }
+
+  update_slot_items(preferences, slot);
+
+  return 0;
+}
+
+int32_t action_load_state(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  const uint8_t slot = item - saves_items - SAVESTATE_SLOTS;
+
+  if (item->disabled) {
+    return 0;
+  }
+
+  // The loaded state did not come from the movie input
+  if (movie_active()) {
+    movie_stop(gb);
+  }
 
-int32_t dummy_function(menu_item *item, gb_s *gb) { return 0; }
+  const uint8_t ret = load_state(gb, slot);
+
+  if (ret != STATE_READ_OK) {
+    savestate_error_alert((ret == STATE_READ_BROKEN)
+                              ? "State broken, game restarted"
+                              : "Loading state failed");
+    update_movie_items(preferences);
+    return 0;
+  }
+
+  strlcpy(item->value, "Loaded", sizeof(item->value));
+  item->value_color = COLOR_SUCCESS;
+
+  update_slot_items(preferences, slot);
+  update_movie_items(preferences);
+
+  return 0;
+}
+
+int32_t action_record_movie(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+  const uint8_t start = (item - saves_items == TAB_SAVES_ITEM_RECORD)
+                            ? MOVIE_START_STATE
+                            : MOVIE_START_RESET;
+
+  if (item->disabled) {
+    return 0;
+  }
+
+  if (movie_state() == MOVIE_RECORDING) {
+    if (movie_stop(gb)) {
+      savestate_error_alert("Saving movie failed");
+    }
+  } else if (movie_record(gb, start)) {
+    savestate_error_alert("Recording movie failed");
+  }
+
+  update_movie_items(preferences);
+
+  return 0;
+}
+
+int32_t action_replay_movie(menu_item *item, gb_s *gb) {
+  emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
+
+  if (item->disabled) {
+    return 0;
+  }
+
+  if (movie_replay(gb)) {
+    savestate_error_alert("Replaying movie failed");
+  }
+
+  update_movie_items(preferences);
+
+  return 0;
+}
 
 menu_tab *prepare_tab_saves(menu_tab *tab, emu_preferences *preferences) {
   // Description for "Saves" tab
   strcpy(tab->title, TAB_SAVES_TITLE);
-  strcpy(tab->description, "Description");
+  strcpy(tab->description, "Save states in " DIRECTORY_SAVES "\\");
 
-  tab->item_count = 1;
-  tab->items = (menu_item *)hhk::malloc(1 * sizeof(menu_item));
+  tab->item_count = TAB_SAVES_ITEM_COUNT;
+  tab->items = (menu_item *)arena_alloc(
+      &session_arena, TAB_SAVES_ITEM_COUNT * sizeof(menu_item));
 
   if (!tab->items) {
     set_error(EMALLOC);
     return nullptr;
   }
 
-  tab->items[0].disabled = false;
-  strcpy(tab->items[0].title, "DUMMY");
-  tab->items[0].value[0] = '\0';
-  tab->items[0].action = dummy_function;
+  saves_items = tab->items;
+
+  char tmp[4];
+
+  for (uint8_t slot = 0; slot < SAVESTATE_SLOTS; slot++) {
+    menu_item *save_item = &tab->items[slot];
+    menu_item *load_item = &tab->items[SAVESTATE_SLOTS + slot];
+
+    itoa(slot + 1, tmp, 10);
+
+    strlcpy(save_item->title, TAB_SAVES_ITEM_SAVE_TITLE,
+            sizeof(save_item->title));
+    strlcat(save_item->title, tmp, sizeof(save_item->title));
+    save_item->disabled = false;
+    save_item->action = action_save_state;
+
+    strlcpy(load_item->title, TAB_SAVES_ITEM_LOAD_TITLE,
+            sizeof(load_item->title));
+    strlcat(load_item->title, tmp, sizeof(load_item->title));
+    load_item->value[0] = '\0';
+    load_item->value_color = COLOR_WHITE;
+    load_item->action = action_load_state;
+
+    update_slot_items(preferences, slot);
+  }
+
+  strlcpy(tab->items[TAB_SAVES_ITEM_RECORD].title, "Record Movie",
+          sizeof(tab->items[TAB_SAVES_ITEM_RECORD].title));
+  tab->items[TAB_SAVES_ITEM_RECORD].disabled = false;
+  tab->items[TAB_SAVES_ITEM_RECORD].action = action_record_movie;
+
+  strlcpy(tab->items[TAB_SAVES_ITEM_RECORD_RESET].title, "Record From Reset",
+          sizeof(tab->items[TAB_SAVES_ITEM_RECORD_RESET].title));
+  tab->items[TAB_SAVES_ITEM_RECORD_RESET].value[0] = '\0';
+  tab->items[TAB_SAVES_ITEM_RECORD_RESET].value_color = COLOR_WHITE;
+  tab->items[TAB_SAVES_ITEM_RECORD_RESET].action = action_record_movie;
+
+  strlcpy(tab->items[TAB_SAVES_ITEM_REPLAY].title, "Replay Movie",
+          sizeof(tab->items[TAB_SAVES_ITEM_REPLAY].title));
+  tab->items[TAB_SAVES_ITEM_REPLAY].action = action_replay_movie;
+
+  update_movie_items(preferences);
 
   return tab;
 }
@@ -1,7 +1,10 @@
 #include "current.h"
 
 #include "../../../core/error.h"
+#include "../../../core/keyboard.h"
+#include "../../../helpers/arena.h"
 #include "../../../helpers/macros.h"
+#include "../../backbuffer.h"
 #include "../../colors.h"
 #include "../../components.h"
 #include "../../effects.h"
@@ -9,25 +12,24 @@
 #include "../../input.h"
 #include "../menu.h"
 #include <sdk/os/debug.hpp>
-#include <sdk/os/input.hpp>
 #include <stdlib.h>
 #include <string.h>
 
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
 #define TAB_SETTINGS_TITLE "Settings"
 #define TAB_SETTINGS_DESCRIPTION "Settings"
 
-#define TAB_SETTINGS_ITEM_COUNT 3
+#define TAB_SETTINGS_ITEM_COUNT 5
 #define TAB_SETTINGS_ITEM_PALETTE_INDEX 0
 #define TAB_SETTINGS_ITEM_PALETTE_TITLE "Custom Color Palettes"
 #define TAB_SETTINGS_ITEM_PALETTE_SUBTITLE "[(-)] to delete"
 #define TAB_SETTINGS_ITEM_CONTROLS_INDEX 1
 #define TAB_SETTINGS_ITEM_CONTROLS_TITLE "Controls"
 #define TAB_SETTINGS_ITEM_CONTROLS_SUBTITLE "Select key to edit"
-#define TAB_SETTINGS_ITEM_CREDITS_INDEX 2
+#define TAB_SETTINGS_ITEM_EXPORT_INDEX 2
+#define TAB_SETTINGS_ITEM_EXPORT_TITLE "Export INI Files"
+#define TAB_SETTINGS_ITEM_IMPORT_INDEX 3
+#define TAB_SETTINGS_ITEM_IMPORT_TITLE "Import INI Files"
+#define TAB_SETTINGS_ITEM_CREDITS_INDEX 4
 #define TAB_SETTINGS_ITEM_CREDITS_TITLE "Credits"
 #define TAB_SETTINGS_ITEM_CREDITS_SUBTITLE CPBOY_VERSION
 #define TAB_SETTINGS_ITEM_CREDITS_CONTENT                                      \
@@ -386,14 +388,8 @@ void draw_palettes_alert(palette *user_palettes, uint8_t user_palette_count,
 }
 
 int32_t select_key_alert(uint32_t *key) {
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   draw_select_key_alert();
 
@@ -401,21 +397,12 @@ int32_t select_key_alert(uint32_t *key) {
 
   wait_input_release();
 
-  while (!Input_IsAnyKeyDown()) {
-  }
-
   // Save the pressed key to the controls array
-  // Do this in a loop because the key buffer might
-  // still be empty even when a key is pressed
-  do {
-    getKey(&(key[0]), &(key[1]));
-  } while (!(key[0] | key[1]));
+  while (!keyboard_read(&(key[0]), &(key[1]))) {
+  }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   wait_input_release();
 
@@ -425,14 +412,8 @@ int32_t select_key_alert(uint32_t *key) {
 int32_t controls_alert(struct gb_s *gb) {
   emu_preferences *preferences = (emu_preferences *)gb->direct.priv;
 
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   uint8_t selected_item = 0;
 
@@ -473,23 +454,14 @@ int32_t controls_alert(struct gb_s *gb) {
   }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
 
 int32_t edit_palette_alert(palette *pal) {
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   uint8_t selected_item = 0;
   uint8_t selected_colors[3] = {0};
@@ -565,10 +537,7 @@ int32_t edit_palette_alert(palette *pal) {
   }
 
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
@@ -578,14 +547,8 @@ int32_t palettes_alert(struct gb_s *gb) {
   palette *user_palettes;
   uint8_t user_palette_count = get_user_palettes(&user_palettes, gb);
 
-  // Backup LCD and darken background
-  uint16_t *lcd_backup = (uint16_t *)hhk::malloc(
-      CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-
-  if (lcd_backup) {
-    memcpy(lcd_backup, vram, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-  }
+  // Darken background, the alert is drawn over it
+  backbuffer_open();
 
   uint8_t selected_item = 0;
 
@@ -616,14 +579,9 @@ int32_t palettes_alert(struct gb_s *gb) {
       if (ret == INPUT_PROC_CLOSE) {
         if (selected_item < user_palette_count) {
           delete_palette(gb, selected_item);
+          // The window gets smaller, which the backbuffer restores once
+          // it is drawn again
           user_palette_count = get_user_palettes(&user_palettes, gb);
-
-          // Restore background as the window gets smaller
-          if (lcd_backup) {
-            memcpy(vram, lcd_backup,
-                   CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-            darken_screen_area(0, 0, CAS_LCD_WIDTH, CAS_LCD_HEIGHT);
-          }
         }
       } else if (ret == INPUT_PROC_EXECUTE) {
         // Check if OK was pressed
@@ -643,6 +601,7 @@ int32_t palettes_alert(struct gb_s *gb) {
 
             continue;
           } else if (ret != 0) {
+            backbuffer_close();
             return MENU_CRASH;
           }
 
@@ -650,18 +609,18 @@ int32_t palettes_alert(struct gb_s *gb) {
         }
 
         edit_palette_alert(&(user_palettes[selected_item]));
-        save_palette(&(user_palettes[selected_item]), selected_item);
+        save_palette(gb, &(user_palettes[selected_item]), selected_item);
       }
     }
 
     LCD_Refresh();
   }
 
+  // Edited or deleted palettes may be the one in use
+  gb_update_palette_lut(gb);
+
   // Close alert
-  if (lcd_backup) {
-    memcpy(vram, lcd_backup, CAS_LCD_HEIGHT * CAS_LCD_WIDTH * sizeof(uint16_t));
-    hhk::free(lcd_backup);
-  }
+  backbuffer_close();
 
   return 0;
 }
@@ -674,6 +633,43 @@ int32_t action_edit_controls(menu_item *item, gb_s *gb) {
   return controls_alert(gb);
 }
 
+void preferences_error_alert(const char *title) {
+  char text[ERROR_MAX_INFO_LEN + 60];
+
+  strlcpy(text, get_error_string(errno), sizeof(text));
+  strlcat(text, "\n", sizeof(text));
+  strlcat(text, error_info, sizeof(text));
+
+  ok_alert(title, nullptr, text, COLOR_DANGER, COLOR_BLACK, COLOR_DANGER);
+}
+
+int32_t action_export_ini(menu_item *item, gb_s *gb) {
+  if (export_preferences_ini(gb)) {
+    preferences_error_alert("Export failed");
+    return 0;
+  }
+
+  strlcpy(item->value, "Exported", sizeof(item->value));
+  item->value_color = COLOR_SUCCESS;
+
+  return 0;
+}
+
+int32_t action_import_ini(menu_item *item, gb_s *gb) {
+  if (import_preferences_ini(gb)) {
+    preferences_error_alert("Import failed");
+    return 0;
+  }
+
+  // The imported palette may be the one in use
+  gb_update_palette_lut(gb);
+
+  strlcpy(item->value, "Imported", sizeof(item->value));
+  item->value_color = COLOR_SUCCESS;
+
+  return 0;
+}
+
 int32_t action_show_credits(menu_item *item, gb_s *gb) {
   ok_alert(TAB_SETTINGS_ITEM_CREDITS_TITLE, TAB_SETTINGS_ITEM_CREDITS_SUBTITLE,
            TAB_SETTINGS_ITEM_CREDITS_CONTENT, COLOR_WHITE, COLOR_MENU_BG,
@@ -687,9 +683,20 @@ menu_tab *prepare_tab_settings(menu_tab *tab, emu_preferences *preferences) {
   strcpy(tab->title, TAB_SETTINGS_TITLE);
   strcpy(tab->description, TAB_SETTINGS_DESCRIPTION);
 
+  // Peak usage of the arenas, the menu arena includes this menu
+  char tmp[12];
+
+  strlcat(tab->description, "\nPeak memory: ROM ", sizeof(tab->description));
+  strlcat(tab->description, itoa(rom_arena.peak / 1024, tmp, 10),
+          sizeof(tab->description));
+  strlcat(tab->description, "KB, Menu ", sizeof(tab->description));
+  strlcat(tab->description, itoa(session_arena.peak / 1024, tmp, 10),
+          sizeof(tab->description));
+  strlcat(tab->description, "KB", sizeof(tab->description));
+
   tab->item_count = TAB_SETTINGS_ITEM_COUNT;
-  tab->items =
-      (menu_item *)hhk::malloc(TAB_SETTINGS_ITEM_COUNT * sizeof(menu_item));
+  tab->items = (menu_item *)arena_alloc(
+      &session_arena, TAB_SETTINGS_ITEM_COUNT * sizeof(menu_item));
 
   if (!tab->items) {
     set_error(EMALLOC);
@@ -699,6 +706,8 @@ menu_tab *prepare_tab_settings(menu_tab *tab, emu_preferences *preferences) {
   // Disabled state for each item
   tab->items[TAB_SETTINGS_ITEM_PALETTE_INDEX].disabled = false;
   tab->items[TAB_SETTINGS_ITEM_CONTROLS_INDEX].disabled = false;
+  tab->items[TAB_SETTINGS_ITEM_EXPORT_INDEX].disabled = false;
+  tab->items[TAB_SETTINGS_ITEM_IMPORT_INDEX].disabled = false;
   tab->items[TAB_SETTINGS_ITEM_CREDITS_INDEX].disabled = false;
 
   // Title for each item
@@ -706,17 +715,25 @@ menu_tab *prepare_tab_settings(menu_tab *tab, emu_preferences *preferences) {
          TAB_SETTINGS_ITEM_PALETTE_TITLE);
   strcpy(tab->items[TAB_SETTINGS_ITEM_CONTROLS_INDEX].title,
          TAB_SETTINGS_ITEM_CONTROLS_TITLE);
+  strcpy(tab->items[TAB_SETTINGS_ITEM_EXPORT_INDEX].title,
+         TAB_SETTINGS_ITEM_EXPORT_TITLE);
+  strcpy(tab->items[TAB_SETTINGS_ITEM_IMPORT_INDEX].title,
+         TAB_SETTINGS_ITEM_IMPORT_TITLE);
   strcpy(tab->items[TAB_SETTINGS_ITEM_CREDITS_INDEX].title,
          TAB_SETTINGS_ITEM_CREDITS_TITLE);
 
   // Value for each item
   tab->items[TAB_SETTINGS_ITEM_PALETTE_INDEX].value[0] = '\0';
   tab->items[TAB_SETTINGS_ITEM_CONTROLS_INDEX].value[0] = '\0';
+  tab->items[TAB_SETTINGS_ITEM_EXPORT_INDEX].value[0] = '\0';
+  tab->items[TAB_SETTINGS_ITEM_IMPORT_INDEX].value[0] = '\0';
   tab->items[TAB_SETTINGS_ITEM_CREDITS_INDEX].value[0] = '\0';
 
   // Action for each item
   tab->items[TAB_SETTINGS_ITEM_PALETTE_INDEX].action = action_edit_palettes;
   tab->items[TAB_SETTINGS_ITEM_CONTROLS_INDEX].action = action_edit_controls;
+  tab->items[TAB_SETTINGS_ITEM_EXPORT_INDEX].action = action_export_ini;
+  tab->items[TAB_SETTINGS_ITEM_IMPORT_INDEX].action = action_import_ini;
   tab->items[TAB_SETTINGS_ITEM_CREDITS_INDEX].action = action_show_credits;
 
   return tab;
@@ -0,0 +1,85 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include "functions.h"
+
+// Keeps the memory behind the block header aligned
+#define ARENA_HEADER_SIZE align_val(sizeof(arena_block), ARENA_ALIGN)
+
+arena session_arena;
+arena rom_arena;
+
+void *arena_alloc(arena *a, size_t size)
+{
+  size = align_val(size, ARENA_ALIGN);
+
+  arena_block *block = a->block;
+
+  // Start a new block if the current one is full. Whatever is left in the 
+  // old block stays unused until the arena is released.
+  if (!block || block->size - block->used < size)
+  {
+    const uint32_t block_size = (size > ARENA_BLOCK_SIZE)? size : ARENA_BLOCK_SIZE;
+
+    block = (arena_block *)malloc(ARENA_HEADER_SIZE + block_size);
+
+    if (!block)
+    {
+      return nullptr;
+    }
+
+    block->prev = a->block;
+    block->size = block_size;
+    block->used = 0;
+    a->block = block;
+  }
+
+  void *mem = (uint8_t *)block + ARENA_HEADER_SIZE + block->used;
+
+  block->used += size;
+  a->used += size;
+
+  if (a->used > a->peak)
+  {
+    a->peak = a->used;
+  }
+
+  return mem;
+}
+
+arena_mark arena_get_mark(arena *a)
+{
+  arena_mark mark;
+
+  mark.block = a->block;
+  mark.block_used = (a->block)? a->block->used : 0;
+  mark.used = a->used;
+
+  return mark;
+}
+
+void arena_release(arena *a, arena_mark mark)
+{
+  // Free the blocks started after the mark
+  while (a->block && a->block != mark.block)
+  {
+    arena_block *prev = a->block->prev;
+
+    free(a->block);
+    a->block = prev;
+  }
+
+  if (a->block)
+  {
+    a->block->used = mark.block_used;
+  }
+
+  a->used = mark.used;
+}
+
+void arena_reset(arena *a)
+{
+  arena_mark empty = { nullptr, 0, 0 };
+
+  arena_release(a, empty);
+}
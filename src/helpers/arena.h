@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Memory is taken from the heap in blocks of at least this size
+#define ARENA_BLOCK_SIZE  0x8000
+#define ARENA_ALIGN       8
+
+struct arena_block
+{
+  arena_block *prev;
+  uint32_t size;
+  uint32_t used;
+};
+
+// Hands out memory from blocks that are only given back all at once, so 
+// many small allocations do not break up the heap
+struct arena
+{
+  // The newest block, older ones follow through prev
+  arena_block *block;
+  // Bytes handed out, and the most ever handed out. Resets keep the peak,
+  // so it covers the whole session.
+  uint32_t used;
+  uint32_t peak;
+};
+
+struct arena_mark
+{
+  arena_block *block;
+  uint32_t block_used;
+  uint32_t used;
+};
+
+// Lives as long as the app, scratch memory is released through marks
+extern arena session_arena;
+
+// Lives as long as the current rom, reset by free_emulator()
+extern arena rom_arena;
+
+/**
+ * Allocates memory from an arena. It stays valid until the arena is reset
+ * or released to a mark taken before.
+ * 
+ * @return Returns the memory, aligned to ARENA_ALIGN, or nullptr if the 
+ * heap is out of memory
+*/
+void *arena_alloc(arena *a, size_t size);
+
+// Remembers how much of the arena is in use
+arena_mark arena_get_mark(arena *a);
+
+// Gives back everything allocated since the mark was taken. Marks have to
+// be released in the reverse order they were taken.
+void arena_release(arena *a, arena_mark mark);
+
+// Gives back all memory of the arena, the peak is kept
+void arena_reset(arena *a);
@@ -60,6 +60,30 @@ uint8_t _read_mcs(const char *dir, const char *name, void **buf, uint32_t *size,
   return 0;
 }
 
+uint8_t _delete_mcs(const char *dir, const char *name, const char *err_file, uint32_t err_line)
+{
+  int32_t ret = MCS_DeleteVariable(dir, name);
+
+  if (ret != 0)
+  {
+    char err_info[100] = "mcs\\";
+    char tmp[10];
+
+    itoa(ret, tmp, 16);
+
+    strlcat(err_info, dir, sizeof(err_info));
+    strlcat(err_info, "\\", sizeof(err_info));
+    strlcat(err_info, name, sizeof(err_info));
+    strlcat(err_info, ": 0x", sizeof(err_info));
+    strlcat(err_info, tmp, sizeof(err_info));
+
+    _set_error(EFWRITE, err_file, err_line, err_info);
+    return 1;
+  }
+
+  return 0;
+}
+
 uint8_t _write_file(const char *file, void *buf, size_t len, const char *err_file, uint32_t err_line)
 {
   int32_t fd = open(file, OPEN_WRITE | OPEN_CREATE);
@@ -166,6 +190,20 @@ uint8_t _get_file_size(const char *file, size_t *size, const char *err_file, uin
   return 0;
 }
 
+bool file_exists(const char *file)
+{
+  int32_t fd = open(file, OPEN_READ);
+
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  close(fd);
+
+  return true;
+}
+
 uint8_t find_files(const char *path, char (*buf)[MAX_FILENAME_LEN], uint8_t max)
 {
   if (max == 0)
@@ -8,6 +8,8 @@
 
 #define read_mcs(dir, name, buf, size) _read_mcs(dir, name, buf, size, __FILE__, __LINE__)
 
+#define delete_mcs(dir, name) _delete_mcs(dir, name, __FILE__, __LINE__)
+
 /**
  * Writes a file and does error handling. The file will be created 
  * if it does not exist
@@ -64,10 +66,20 @@
 */
 uint8_t find_files(const char *path, char (*buf)[MAX_FILENAME_LEN], uint8_t max);
 
+/**
+ * Checks if a file exists. Does not set an error if it does not.
+ *   
+ * @param file  The file to be checked
+ * 
+ * @return Returns true if the file can be opened for reading
+*/
+bool file_exists(const char *file);
+
 uint8_t _write_mcs(const char *dir, const char *name, void *buf, size_t len, 
   const char *err_file, uint32_t err_line);
 uint8_t _read_mcs(const char *dir, const char *name, void **buf, uint32_t *len, 
   const char *err_file, uint32_t err_line);
+uint8_t _delete_mcs(const char *dir, const char *name, const char *err_file, uint32_t err_line);
 uint8_t _write_file(const char *file, void *buf, size_t len, const char *err_file, uint32_t err_line);
 uint8_t _read_file(const char *file, void *buf, size_t len, const char *err_file, uint32_t err_line);
 uint8_t _delete_file(const char *file, const char *err_file, uint32_t err_line);
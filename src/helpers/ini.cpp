@@ -1,398 +1,274 @@
 #include "ini.h"
 
-#include "../core/error.h"
-#include "../emu_ui/font.h"
-#include "../helpers/functions.h"
-#include <sdk/os/debug.hpp>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+struct ini_bind_state {
+  const ini_binding *bindings;
+  uint8_t count;
+  uint8_t *base;
+  uint32_t found;
+};
+
+static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Copies a token into a fixed buffer with surrounding blanks removed
+static void copy_token(char *dest, uint32_t size, const char *start,
+                       const char *end) {
+  while (start < end && is_blank(*start)) {
+    start++;
+  }
 
-// Use namespace because of conflicting function declarations in mem.hpp and
-// string.h
-namespace hhk {
-#include <sdk/os/mem.hpp>
-}
-
-#define TMP_STRING_LEN INI_MAX_VALUE_LEN
-#define INI_LINE_TYPE_SECTION 0
-#define INI_LINE_TYPE_KEY 1
-#define INI_LINE_TYPE_COMMENT 2
-
-void *double_space(void *src, uint32_t *size, size_t elem_size) {
-  uint32_t old_size = *size;
-
-  // Allocate double current size
-  *size = (*size == 0) ? 1 : *size * 2;
+  while (end > start && is_blank(*(end - 1))) {
+    end--;
+  }
 
-  void *new_space = hhk::malloc((*size) * elem_size);
+  uint32_t len = end - start;
 
-  if (!new_space) {
-    char err_info[ERROR_MAX_INFO_LEN];
-    char tmp[20];
+  if (len >= size) {
+    len = size - 1;
+  }
 
-    strlcpy(err_info, ".ini Parsing: ", sizeof(err_info));
-    strlcat(err_info, itoa((*size) * elem_size, tmp, 10), sizeof(err_info));
-    strlcat(err_info, "B", sizeof(err_info));
+  memcpy(dest, start, len);
+  dest[len] = '\0';
+}
 
-    set_error_i(EMALLOC, err_info);
+// Same as atoi, but keeps the bits of negative values written for uint32_t
+static uint32_t parse_int(const char *p, const char *end) {
+  bool negative = false;
+  uint32_t value = 0;
 
-    return nullptr;
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
   }
 
-  // Copy old data to new space
-  if (old_size != 0) {
-    memcpy(new_space, src, old_size * elem_size);
-    hhk::free(src);
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    value = value * 10 + (*p - '0');
   }
 
-  return new_space;
+  return negative ? (uint32_t)(-(int32_t)value) : value;
 }
 
-ini_file *ini_parse(const char *ini_string, uint32_t len, ini_file *file) {
-  uint8_t char_counter = 0;
-
-  const char *p = ini_string;
-  char tmp[TMP_STRING_LEN];
-
-  bool quotes_opened = false;
-
-  uint8_t line_type = INI_LINE_TYPE_KEY;
-
-  ini_section *tmp_section = nullptr;
-  ini_key *tmp_key = nullptr;
-
-  // init ini_file
-  file->section_count = 0;
-  file->sections_size = 0;
-  file->sections = nullptr;
-
-  // Go through each character and parse
-  for (uint32_t i = 0; *p && i < len; i++, p++) {
-    switch (*p) {
-    case ';':
-    case '#':
-      line_type = INI_LINE_TYPE_COMMENT;
-      break;
-
-    case '[':
-      char_counter = 0;
-      break;
+static uint8_t parse_line(const char *p, const char *end, char *section,
+                          ini_handler handler, void *user) {
+  while (p < end && is_blank(*p)) {
+    p++;
+  }
 
-    case ']':
-      if (line_type == INI_LINE_TYPE_COMMENT) {
-        break;
-      }
+  if (p == end || *p == ';' || *p == '#') {
+    return 0;
+  }
 
-      tmp[char_counter] = '\0';
-      char_counter = 0;
+  if (*p == '[') {
+    const char *close = (const char *)memchr(p, ']', end - p);
 
-      tmp_section = add_section(file, tmp);
+    if (close) {
+      copy_token(section, INI_MAX_SECTION_LEN, p + 1, close);
+    }
 
-      if (!tmp_section) {
-        free_ini_file(file);
-        return nullptr;
-      }
+    return 0;
+  }
 
-      break;
+  const char *equals = (const char *)memchr(p, '=', end - p);
 
-    case '=':
-      if (line_type == INI_LINE_TYPE_COMMENT || !tmp_section) {
-        break;
-      }
+  // Keys outside of a section are ignored
+  if (!equals || section[0] == '\0') {
+    return 0;
+  }
 
-      tmp[char_counter] = '\0';
-      char_counter = 0;
+  char key[INI_MAX_KEY_LEN];
+  copy_token(key, sizeof(key), p, equals);
 
-      tmp_key = add_key(tmp_section, tmp);
+  ini_value value;
+  p = equals + 1;
 
-      if (!tmp_key) {
-        free_ini_file(file);
-        return nullptr;
-      }
-      break;
+  while (p < end && is_blank(*p)) {
+    p++;
+  }
 
-    case '"':
-      if (!tmp_key) {
-        break;
-      }
+  if (p < end && *p == '"') {
+    const char *close = (const char *)memchr(p + 1, '"', end - p - 1);
 
-      tmp[char_counter] = '\0';
+    value.str = p + 1;
+    value.len = (close ? close : end) - value.str;
+    value.value_int = 0;
+    value.value_type = INI_TYPE_STRING;
+  } else {
+    const char *value_end = end;
 
-      if (quotes_opened) {
-        tmp_key->value_type = INI_TYPE_STRING;
-        tmp_key->value_int = 0;
+    while (value_end > p && is_blank(*(value_end - 1))) {
+      value_end--;
+    }
 
-        strlcpy(tmp_key->value_str, tmp, sizeof(tmp_key->value_str));
-      } else {
-        quotes_opened = true;
-        char_counter = 0;
-      }
+    value.str = p;
+    value.len = value_end - p;
+    value.value_int = parse_int(p, value_end);
+    value.value_type = INI_TYPE_INT;
+  }
 
-      char_counter = 0;
-      break;
+  return handler(user, section, key, &value);
+}
 
-    case '\n':
-      // If reached end of line and tmp string is not empty and has key, add the
-      // value of the tmp string as integer value to key.
-      if (tmp_key && char_counter != 0 && !quotes_opened) {
-        tmp[char_counter] = '\0';
-        tmp_key->value_type = INI_TYPE_INT;
-        tmp_key->value_int = atoi(tmp);
-        tmp_key->value_str[0] = '\0';
-      }
+uint8_t ini_parse(const char *ini_string, uint32_t len, ini_handler handler,
+                  void *user) {
+  const char *p = ini_string;
+  const char *end = ini_string + len;
+  char section[INI_MAX_SECTION_LEN] = "";
 
-      tmp_key = nullptr;
-      char_counter = 0;
-      line_type = INI_LINE_TYPE_KEY;
-      quotes_opened = false;
-      break;
+  // Mcs variables are padded with zeros, so a null ends the buffer as well
+  while (p < end && *p) {
+    const char *line_end = p;
 
-    case ' ':
-      // Only process space when in quotes
-      if (!quotes_opened) {
-        break;
-      }
-      // Intentional fallthrough
+    while (line_end < end && *line_end && *line_end != '\n') {
+      line_end++;
+    }
 
-    default:
-      if (char_counter < TMP_STRING_LEN) {
-        tmp[char_counter] = *p;
-        char_counter++;
-      }
-      break;
+    if (parse_line(p, line_end, section, handler, user)) {
+      return 1;
     }
+
+    p = (line_end < end && *line_end == '\n') ? line_end + 1 : line_end;
   }
 
-  return file;
+  return 0;
 }
 
-char *ini_write(ini_file *file, char *ini_string, uint32_t len) {
-  uint32_t remaining_len = len;
-
-  ini_string[0] = '\0';
-
-  // Go through each section, write the corresponding header and its keys
-  for (uint32_t i = 0; i < file->section_count; i++) {
-    ini_section *section = &(file->sections[i]);
+static uint8_t bind_key(void *user, const char *section, const char *key,
+                        const ini_value *value) {
+  ini_bind_state *state = (ini_bind_state *)user;
 
-    // Write header
-    strncat(ini_string, "[", remaining_len);
-    ini_string[len - 1] = '\0';
+  for (uint8_t i = 0; i < state->count; i++) {
+    const ini_binding *binding = &(state->bindings[i]);
 
-    if (remaining_len < 1) {
-      break;
+    if (strcmp(binding->key, key) != 0 ||
+        strcmp(binding->section, section) != 0) {
+      continue;
     }
 
-    remaining_len -= 1;
-
-    strncat(ini_string, section->name, remaining_len);
-    ini_string[len - 1] = '\0';
+    uint8_t *field = state->base + binding->offset;
 
-    if (remaining_len < strlen(section->name)) {
+    switch (binding->type) {
+    case INI_FIELD_BOOL:
+      *(bool *)field = value->value_int != 0;
       break;
-    }
-
-    remaining_len -= strlen(section->name);
 
-    strncat(ini_string, "]\n", remaining_len);
-    ini_string[len - 1] = '\0';
-
-    if (remaining_len < 2) {
+    case INI_FIELD_U8:
+      *field = value->value_int;
       break;
-    }
-
-    remaining_len -= 2;
 
-    // Write keys
-    for (uint32_t j = 0; j < section->key_count; j++) {
-
-      ini_key *key = &(section->keys[j]);
-
-      strncat(ini_string, key->name, remaining_len);
-      ini_string[len - 1] = '\0';
-
-      if (remaining_len < strlen(key->name)) {
-        break;
-      }
-
-      remaining_len -= strlen(key->name);
-
-      strncat(ini_string, "=", remaining_len);
-      ini_string[len - 1] = '\0';
-
-      if (remaining_len < 1) {
-        break;
-      }
-
-      remaining_len--;
-
-      // Write actual value
-      if (key->value_type == INI_TYPE_INT) {
-        char tmp[12];
-        itoa(key->value_int, tmp, 10);
-
-        strncat(ini_string, tmp, remaining_len);
-        ini_string[len - 1] = '\0';
-
-        if (remaining_len < strlen(tmp)) {
-          break;
-        }
-
-        remaining_len -= strlen(tmp);
-      } else {
-        strncat(ini_string, "\"", remaining_len);
-        ini_string[len - 1] = '\0';
-
-        if (remaining_len < 1) {
-          break;
-        }
-
-        remaining_len -= 1;
-
-        strncat(ini_string, key->value_str, remaining_len);
-        ini_string[len - 1] = '\0';
-
-        if (remaining_len < strlen(key->value_str)) {
-          break;
-        }
-
-        remaining_len -= strlen(key->value_str);
-
-        strncat(ini_string, "\"", remaining_len);
-        ini_string[len - 1] = '\0';
-
-        if (remaining_len < 1) {
-          break;
-        }
+    case INI_FIELD_U16:
+      *(uint16_t *)field = value->value_int;
+      break;
 
-        remaining_len -= 1;
-      }
+    case INI_FIELD_U32:
+      *(uint32_t *)field = value->value_int;
+      break;
 
-      strncat(ini_string, "\n", remaining_len);
-      ini_string[len - 1] = '\0';
+    case INI_FIELD_STR: {
+      uint32_t len = value->len;
 
-      if (remaining_len < 1) {
-        break;
+      if (len >= binding->size) {
+        len = binding->size - 1;
       }
 
-      remaining_len -= 1;
+      memcpy(field, value->str, len);
+      field[len] = '\0';
+      break;
+    }
     }
+
+    state->found |= 1 << i;
+    break;
   }
 
-  return ini_string;
+  return 0;
 }
 
-// Searches a section by name in a section array and returns a pointer if found
-ini_section *find_section(const ini_file *file, const char *name) {
-  if (!file) {
-    return nullptr;
-  }
+uint32_t ini_read_bindings(const char *ini_string, uint32_t len,
+                           const ini_binding *bindings, uint8_t count,
+                           void *base) {
+  ini_bind_state state = {bindings, count, (uint8_t *)base, 0};
 
-  for (uint32_t i = 0; i < file->section_count; i++) {
-    if (strncmp(file->sections[i].name, name, TMP_STRING_LEN) == 0) {
-      return &(file->sections[i]);
-    }
-  }
+  ini_parse(ini_string, len, bind_key, &state);
 
-  return nullptr;
+  return state.found;
 }
 
-// Searches a key by name in a keys array and returns a pointer if found
-ini_key *find_key(const ini_section *section, const char *name) {
-  if (!section) {
-    return nullptr;
-  }
+// Appends str if it fits and keeps the buffer null terminated
+static bool append(char *ini_string, uint32_t len, uint32_t *pos,
+                   const char *str) {
+  uint32_t str_len = strlen(str);
 
-  for (uint32_t i = 0; i < section->key_count; i++) {
-    if (strncmp(section->keys[i].name, name, TMP_STRING_LEN) == 0) {
-      return &(section->keys[i]);
-    }
+  if (*pos + str_len >= len) {
+    return false;
   }
 
-  return nullptr;
-}
-
-void free_ini_file(ini_file *file) {
-  for (uint32_t i = 0; i < file->section_count; i++) {
-    hhk::free(file->sections[i].keys);
-    file->sections->keys = nullptr;
-  }
+  memcpy(ini_string + *pos, str, str_len + 1);
+  *pos += str_len;
 
-  hhk::free(file->sections);
-  file->sections = nullptr;
+  return true;
 }
 
-ini_key *add_key(ini_section *section, const char *name, uint8_t value_type,
-                 uint32_t value_int, const char *value_str) {
-  if (!section) {
-    return nullptr;
-  }
-
-  ini_key *tmp_key = find_key(section, name);
+char *ini_write_bindings(const ini_binding *bindings, uint8_t count,
+                         const void *base, char *ini_string, uint32_t len) {
+  uint32_t pos = 0;
+  const char *section = nullptr;
 
-  // If key could not be found, create a new key in the keys array.
-  // We first check if new space needs to be allocated. If so, we will double
-  // the available space.
-  if (!tmp_key) {
-    if (section->key_count == section->keys_size) {
-      section->keys = (ini_key *)double_space(
-          section->keys, &(section->keys_size), sizeof(ini_key));
-
-      if (!section->keys) {
-        return nullptr;
-      }
-    }
+  ini_string[0] = '\0';
 
-    tmp_key = &(section->keys[section->key_count]);
-    section->key_count++;
+  for (uint8_t i = 0; i < count; i++) {
+    const ini_binding *binding = &(bindings[i]);
+    const uint8_t *field = (const uint8_t *)base + binding->offset;
+    bool fits = true;
 
-    // Set values for newly created key
-    tmp_key->value_type = value_type;
-    tmp_key->value_int = value_int;
+    // Bindings of a section follow each other, so a header is only needed
+    // when the section changes
+    if (!section || strcmp(section, binding->section) != 0) {
+      section = binding->section;
 
-    // Use valuestr if it was specified, else fill it with 0s
-    if (value_str) {
-      strlcpy(tmp_key->value_str, value_str, sizeof(tmp_key->value_str));
-    } else {
-      memset(tmp_key->value_str, 0, sizeof(tmp_key->value_str));
+      fits = append(ini_string, len, &pos, "[") &&
+             append(ini_string, len, &pos, section) &&
+             append(ini_string, len, &pos, "]\n");
     }
 
-    // Set name of key
-    strlcpy(tmp_key->name, name, sizeof(tmp_key->name));
-  }
+    fits = fits && append(ini_string, len, &pos, binding->key) &&
+           append(ini_string, len, &pos, "=");
 
-  return tmp_key;
-}
+    if (binding->type == INI_FIELD_STR) {
+      fits = fits && append(ini_string, len, &pos, "\"") &&
+             append(ini_string, len, &pos, (const char *)field) &&
+             append(ini_string, len, &pos, "\"");
+    } else {
+      uint32_t value;
+      char tmp[12];
 
-ini_section *add_section(ini_file *file, const char *name) {
-  if (!file) {
-    return nullptr;
-  }
+      switch (binding->type) {
+      case INI_FIELD_BOOL:
+        value = *(const bool *)field;
+        break;
 
-  ini_section *tmp_section = find_section(file, name);
+      case INI_FIELD_U8:
+        value = *field;
+        break;
 
-  // If section could not be found, create a new section in the sections array.
-  // We first check if new space needs to be allocated. If so, we will double
-  // the available space.
-  if (!tmp_section) {
-    if (file->section_count == file->sections_size) {
-      file->sections = (ini_section *)double_space(
-          file->sections, &(file->sections_size), sizeof(ini_section));
+      case INI_FIELD_U16:
+        value = *(const uint16_t *)field;
+        break;
 
-      if (!file->sections) {
-        return nullptr;
+      default:
+        value = *(const uint32_t *)field;
+        break;
       }
-    }
 
-    tmp_section = &(file->sections[file->section_count]);
-    file->section_count++;
+      fits = fits && append(ini_string, len, &pos, itoa(value, tmp, 10));
+    }
 
-    // Set default values for newly created section
-    tmp_section->key_count = 0;
-    tmp_section->keys_size = 0;
-    tmp_section->keys = nullptr;
-    strlcpy(tmp_section->name, name, sizeof(tmp_section->name));
+    if (!(fits && append(ini_string, len, &pos, "\n"))) {
+      return nullptr;
+    }
   }
 
-  return tmp_section;
+  return ini_string;
 }
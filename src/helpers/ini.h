@@ -1,54 +1,55 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
-#include "macros.h"
 
 #define INI_MAX_SECTION_LEN 20
 #define INI_MAX_KEY_LEN     20
-#define INI_MAX_VALUE_LEN   MAX_FILENAME_LEN
 #define INI_MAX_CONTENT_LEN 1024
 
 #define INI_TYPE_INT    0
 #define INI_TYPE_STRING 1
 
+#define INI_FIELD_BOOL  0
+#define INI_FIELD_U8    1
+#define INI_FIELD_U16   2
+#define INI_FIELD_U32   3
+#define INI_FIELD_STR   4
 
-struct ini_key
+// Binds a key of a section to a field of the struct owner
+#define INI_BIND(section, key, type, owner, field) \
+  { section, key, type, offsetof(owner, field), sizeof(((owner *)0)->field) }
+
+struct ini_value
 {
-  char name[INI_MAX_KEY_LEN];
-  char value_str[INI_MAX_VALUE_LEN];
+  // Points into the parsed buffer and is not null terminated
+  const char *str;
+  uint32_t len;
   uint32_t value_int;
   uint8_t value_type;
 };
 
-struct ini_section
-{
-  char name[INI_MAX_SECTION_LEN];
-  ini_key *keys;
-  uint32_t key_count;
-  uint32_t keys_size;
-};
-
-struct ini_file
+struct ini_binding
 {
-  ini_section *sections;
-  uint32_t section_count;
-  uint32_t sections_size;
+  const char *section;
+  const char *key;
+  uint8_t type;
+  uint16_t offset;
+  uint16_t size;
 };
 
+// Called for every key in a section, a non zero return stops parsing
+typedef uint8_t (*ini_handler)(void *user, const char *section,
+  const char *key, const ini_value *value);
 
-// TODO: MUST BE FREED
-// ini_file *ini_parse(const char *ini_string, uint32_t len, ini_file *file);
-ini_file *ini_parse(const char *ini_string, uint32_t len, ini_file *file);
-
-char *ini_write(ini_file *file, char *ini_string, uint32_t len);
-
-ini_section *find_section(const ini_file *file, const char *name);
-
-ini_key *find_key(const ini_section *section, const char *name);
-
-void free_ini_file(ini_file *file);
+// Walks the buffer without allocating and calls handler for every key
+uint8_t ini_parse(const char *ini_string, uint32_t len, ini_handler handler,
+  void *user);
 
-ini_key *add_key(ini_section *section, const char *name, uint8_t value_type = INI_TYPE_INT, 
-  uint32_t value_int = 0, const char *value_str = nullptr);
+// Stores all bound keys into base, returns a bit per binding that was found
+uint32_t ini_read_bindings(const char *ini_string, uint32_t len,
+  const ini_binding *bindings, uint8_t count, void *base);
 
-ini_section *add_section(ini_file *file, const char *name);
+// Writes the bound fields of base, returns nullptr if they did not fit
+char *ini_write_bindings(const ini_binding *bindings, uint8_t count,
+  const void *base, char *ini_string, uint32_t len);
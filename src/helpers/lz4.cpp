@@ -0,0 +1,241 @@
+#include "lz4.h"
+
+#include <string.h>
+
+#define LZ4_MIN_MATCH     4
+// The last match has to start this many bytes before the end of the input
+#define LZ4_MATCH_LIMIT   12
+// And the last bytes of the input are always literals
+#define LZ4_LAST_LITERALS 5
+
+// Reads the additional bytes of a literal or match length
+static inline bool read_length(const uint8_t **ip, const uint8_t *ip_end, uint32_t *len)
+{
+  uint8_t byte;
+
+  do
+  {
+    if (*ip >= ip_end)
+    {
+      return false;
+    }
+
+    byte = *((*ip)++);
+    *len += byte;
+  } 
+  while (byte == 255);
+
+  return true;
+}
+
+// Writes the additional bytes of a literal or match length
+static inline uint8_t *write_length(uint8_t *op, uint32_t len)
+{
+  while (len >= 255)
+  {
+    *op++ = 255;
+    len -= 255;
+  }
+
+  *op++ = len;
+
+  return op;
+}
+
+// Reads 4 bytes without an aligned load
+static inline uint32_t read_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t hash_u32(uint32_t sequence)
+{
+  return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+// Writes a sequence of literals followed by a match, or only literals if 
+// match_len is 0
+static inline uint8_t *write_sequence(uint8_t *op, const uint8_t *op_end, 
+  const uint8_t *literals, uint32_t lit_len, uint16_t offset, uint32_t match_len)
+{
+  // Token, length bytes, literals, offset
+  if ((uint32_t)(op_end - op) < 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1)
+  {
+    return nullptr;
+  }
+
+  uint8_t *token = op++;
+
+  *token = ((lit_len >= 15)? 15 : lit_len) << 4;
+
+  if (lit_len >= 15)
+  {
+    op = write_length(op, lit_len - 15);
+  }
+
+  memcpy(op, literals, lit_len);
+  op += lit_len;
+
+  if (!match_len)
+  {
+    return op;
+  }
+
+  *op++ = offset & 0xFF;
+  *op++ = offset >> 8;
+
+  match_len -= LZ4_MIN_MATCH;
+  *token |= (match_len >= 15)? 15 : match_len;
+
+  if (match_len >= 15)
+  {
+    op = write_length(op, match_len - 15);
+  }
+
+  return op;
+}
+
+int32_t lz4_compress(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len, 
+  uint16_t *table)
+{
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  uint8_t *op = dst;
+  const uint8_t *op_end = dst + dst_len;
+
+  if (src_len > LZ4_MAX_INPUT)
+  {
+    return -1;
+  }
+
+  if (src_len > LZ4_MATCH_LIMIT)
+  {
+    const uint8_t *match_limit = src + src_len - LZ4_MATCH_LIMIT;
+    const uint8_t *match_end = src + src_len - LZ4_LAST_LITERALS;
+
+    memset(table, 0, LZ4_TABLE_SIZE * sizeof(uint16_t));
+
+    while (ip < match_limit)
+    {
+      const uint32_t sequence = read_u32(ip);
+      const uint32_t hash = hash_u32(sequence);
+      const uint8_t *ref = src + table[hash];
+
+      table[hash] = ip - src;
+
+      // Empty entries point to the start, which is checked like any other
+      if (ref >= ip || read_u32(ref) != sequence)
+      {
+        ip++;
+        continue;
+      }
+
+      const uint8_t *end = ip + LZ4_MIN_MATCH;
+
+      while (end < match_end && *end == ref[end - ip])
+      {
+        end++;
+      }
+
+      op = write_sequence(op, op_end, anchor, ip - anchor, ip - ref, end - ip);
+
+      if (!op)
+      {
+        return -1;
+      }
+
+      ip = end;
+      anchor = ip;
+    }
+  }
+
+  op = write_sequence(op, op_end, anchor, src + src_len - anchor, 0, 0);
+
+  if (!op)
+  {
+    return -1;
+  }
+
+  return op - dst;
+}
+
+int32_t lz4_decompress(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len)
+{
+  const uint8_t *ip = src;
+  const uint8_t *ip_end = src + src_len;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_len;
+
+  while (ip < ip_end)
+  {
+    const uint8_t token = *ip++;
+    uint32_t len = token >> 4;
+
+    // Literals
+    if (len == 15 && !read_length(&ip, ip_end, &len))
+    {
+      return -1;
+    }
+
+    if (len > (uint32_t)(ip_end - ip) || len > (uint32_t)(op_end - op))
+    {
+      return -1;
+    }
+
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+
+    // The last sequence only has literals
+    if (ip == ip_end)
+    {
+      break;
+    }
+
+    // Match
+    if (ip_end - ip < 2)
+    {
+      return -1;
+    }
+
+    const uint16_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+
+    if (offset == 0 || offset > (uint32_t)(op - dst))
+    {
+      return -1;
+    }
+
+    len = token & 0x0F;
+
+    if (len == 15 && !read_length(&ip, ip_end, &len))
+    {
+      return -1;
+    }
+
+    len += 4;
+
+    if (len > (uint32_t)(op_end - op))
+    {
+      return -1;
+    }
+
+    // Matches may overlap with the bytes they produce
+    const uint8_t *match = op - offset;
+
+    if (offset >= len)
+    {
+      memcpy(op, match, len);
+      op += len;
+    }
+    else
+    {
+      while (len--)
+      {
+        *op++ = *match++;
+      }
+    }
+  }
+
+  return op - dst;
+}
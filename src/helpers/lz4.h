@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hash table entries lz4_compress() needs as work memory
+#define LZ4_HASH_BITS   12
+#define LZ4_TABLE_SIZE  (1 << LZ4_HASH_BITS)
+
+// Largest input lz4_compress() accepts, positions are kept as 16 bit
+#define LZ4_MAX_INPUT   0xFFFF
+
+/**
+ * Decompresses an LZ4 block (without frame header).
+ *   
+ * @param src     The compressed block
+ * @param src_len The size of the compressed block
+ * @param dst     The buffer to decompress to
+ * @param dst_len The size of the buffer
+ * 
+ * @return Returns the decompressed size or -1 if the block is invalid
+*/
+int32_t lz4_decompress(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len);
+
+/**
+ * Compresses data to an LZ4 block (without frame header) using a single 
+ * hash table lookup per position. Fast rather than small.
+ *   
+ * @param src     The data, at most LZ4_MAX_INPUT bytes
+ * @param src_len The size of the data
+ * @param dst     The buffer to compress to
+ * @param dst_len The size of the buffer
+ * @param table   Work memory of LZ4_TABLE_SIZE entries
+ * 
+ * @return Returns the compressed size or -1 if it does not fit into dst
+*/
+int32_t lz4_compress(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len, 
+  uint16_t *table);
@@ -17,8 +17,15 @@
 #define DIRECTORY_MAIN     "\\fls0\\CPBoy\\"
 #define DIRECTORY_ROM      DIRECTORY_MAIN "roms"
 #define DIRECTORY_BIN      DIRECTORY_MAIN "bin"
+#define DIRECTORY_SAVES    DIRECTORY_MAIN "saves"
 
 #define EXTENSION_ROM     ".gbc"
+#define EXTENSION_ROM_PACKED ".gbz"
+#define EXTENSION_SAVE    ".sav"
+#define EXTENSION_SAVESTATE ".st"
+#define EXTENSION_RESUME  ".res"
+#define EXTENSION_MOVIE   ".mov"
+#define EXTENSION_MOVIE_START ".mvs"
 
 #define TOGGLE(value) ((value) = !(value))
 
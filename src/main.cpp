@@ -27,6 +27,7 @@
 #include "cas/bootstrap.h"
 #include "core/emulator.h"
 #include "core/error.h"
+#include "helpers/arena.h"
 
 APP_NAME("CPBoy")
 APP_DESCRIPTION("A Gameboy (DMG) emulator. Forked from PeanutGB by deltabeard.")
@@ -54,6 +55,10 @@ int32_t main()
   }
 
 end:
+  // Give back what is left before returning to the OS
+  arena_reset(&rom_arena);
+  arena_reset(&session_arena);
+
   restore_cas(); 
   calcEnd();
   return 0;
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Packs Game Boy ROMs into the .gbz format read by CPBoy.
+
+Every 16KB bank is compressed as its own LZ4 block, so the emulator can
+decompress any bank without reading the ones before it. Banks that do not
+get smaller are stored as they are.
+
+File layout, all values little endian:
+  0   4   Magic "GBZ1"
+  4   4   Size of the original ROM in bytes
+  8   2   Bank count
+  10  2   Reserved, 0
+  12  4n  Offset of every bank from the start of the file, followed by
+          the end offset of the last bank
+
+Usage: gbzpack.py rom.gbc [rom2.gbc ...]
+Writes rom.gbz next to every ROM and prints the size and packing time.
+"""
+
+import struct
+import sys
+import time
+from pathlib import Path
+
+BANK_SIZE = 0x4000
+MAX_BANKS = 512
+MAGIC = b"GBZ1"
+
+MIN_MATCH = 4
+# LZ4 block rules: the last 5 bytes are literals and the last match
+# starts at least 12 bytes before the end
+LAST_LITERALS = 5
+MATCH_LIMIT = 12
+MAX_OFFSET = 0xFFFF
+
+
+def write_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def write_sequence(out, literals, offset=0, match_len=0):
+    lit_len = len(literals)
+    match_code = match_len - MIN_MATCH if offset else 0
+
+    out.append((min(lit_len, 15) << 4) | (min(match_code, 15) if offset else 0))
+
+    if lit_len >= 15:
+        write_length(out, lit_len - 15)
+
+    out += literals
+
+    if offset:
+        out += struct.pack("<H", offset)
+
+        if match_code >= 15:
+            write_length(out, match_code - 15)
+
+
+def lz4_compress(data):
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = len(data) - MATCH_LIMIT
+
+    while i < limit:
+        key = data[i:i + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = i
+
+        if candidate is None or i - candidate > MAX_OFFSET:
+            i += 1
+            continue
+
+        length = MIN_MATCH
+        max_length = len(data) - LAST_LITERALS - i
+
+        while length < max_length and data[candidate + length] == data[i + length]:
+            length += 1
+
+        write_sequence(out, data[anchor:i], i - candidate, length)
+        i += length
+        anchor = i
+
+    write_sequence(out, data[anchor:])
+
+    return bytes(out)
+
+
+def pack(rom):
+    bank_count = max(2, (len(rom) + BANK_SIZE - 1) // BANK_SIZE)
+
+    if bank_count > MAX_BANKS:
+        raise ValueError("ROM has more than %d banks" % MAX_BANKS)
+
+    # The last bank is padded like unused ROM space
+    padded = rom + b"\xFF" * (bank_count * BANK_SIZE - len(rom))
+    blocks = []
+
+    for bank in range(bank_count):
+        raw = padded[bank * BANK_SIZE:(bank + 1) * BANK_SIZE]
+        block = lz4_compress(raw)
+
+        # A block of the full bank size is read as stored
+        blocks.append(block if len(block) < BANK_SIZE else raw)
+
+    offset = 12 + 4 * (bank_count + 1)
+    offsets = []
+
+    for block in blocks:
+        offsets.append(offset)
+        offset += len(block)
+
+    offsets.append(offset)
+
+    header = MAGIC + struct.pack("<IHH", len(rom), bank_count, 0)
+    index = struct.pack("<%dI" % len(offsets), *offsets)
+
+    return header + index + b"".join(blocks)
+
+
+def main(args):
+    if not args:
+        print("Usage: gbzpack.py rom.gbc [rom2.gbc ...]")
+        return 1
+
+    total_in = 0
+    total_out = 0
+
+    for name in args:
+        src = Path(name)
+        rom = src.read_bytes()
+
+        start = time.perf_counter()
+        packed = pack(rom)
+        elapsed = time.perf_counter() - start
+
+        dst = src.with_suffix(".gbz")
+        dst.write_bytes(packed)
+
+        total_in += len(rom)
+        total_out += len(packed)
+
+        print("%s: %d -> %d bytes (%.1f%%), %.2fs" % (
+            dst.name, len(rom), len(packed), 100.0 * len(packed) / len(rom), elapsed))
+
+    if len(args) > 1:
+        print("total: %d -> %d bytes (%.1f%%)" % (
+            total_in, total_out, 100.0 * total_out / total_in))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))